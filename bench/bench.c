@@ -0,0 +1,604 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+/*
+ * Handler and collector microbenchmark.
+ *
+ * The module is initialized against the synthetic data sources, the
+ * prTable and extTable rows are configured with SETs, the plugin rows of
+ * extTable are run once to fill extOutputTable, and then every
+ * handler is driven the way bsnmpd does it for GETNEXT walks, GETs of the
+ * instances found by the walk and GETBULK requests (columns of a table
+ * walked side by side, max-repetitions at a time). The repeat timers of
+ * the module are timed separately. Time is reported in ns and module
+ * allocations are counted per varbind or per timer call.
+ */
+
+#include <sys/types.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "snmp_ucd.h"
+#include "bench.h"
+
+enum { B_GET, B_GETNEXT, B_GETBULK, B_NOPS };
+
+static const char *opnames[B_NOPS] = { "GET", "GETNEXT", "GETBULK" };
+
+struct result {
+	uint64_t	varbinds;
+	uint64_t	ns;
+	uint64_t	allocs;
+};
+
+/* Instance found by a walk. */
+struct instance {
+	const struct snmp_node	*node;
+	struct asn_oid		var;
+};
+
+struct handler {
+	const struct ucd_op	*op;
+	const struct snmp_node	**nodes;	/* Nodes of the handler. */
+	u_int			nnodes;
+	struct instance		*inst;		/* Instances of the nodes. */
+	u_int			ninst;
+	u_int			ainst;
+	struct result		res[B_NOPS];
+};
+
+static struct handler *handlers;
+static u_int nhandlers;
+
+static int niter = 100;
+static int reps = 10;
+static int npr = 16;
+static int next = 16;
+static int nplugin = 8;
+static int nplugin_lines = 8;
+
+/* Time to wait for the plugin rows, in ms. */
+#define PLUGIN_WAIT	10000
+
+static struct snmp_scratch scratch;
+static struct snmp_context context = { .scratch = &scratch };
+
+static uint64_t
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static const struct snmp_node *
+node_find(const char *name)
+{
+	u_int i;
+
+	for (i = 0; i < config.tree_size; i++)
+		if (strcmp(config.tree[i].name, name) == 0)
+			return (&config.tree[i]);
+	fprintf(stderr, "ucdbench: no node %s\n", name);
+	exit(1);
+}
+
+static void
+value_free(struct snmp_value *value)
+{
+
+	if (value->syntax == SNMP_SYNTAX_OCTETSTRING)
+		free(value->v.octetstring.octets);
+	value->v.octetstring.octets = NULL;
+}
+
+/* Call the handler of the node for the instance var. */
+static int
+node_op(const struct snmp_node *np, struct snmp_value *value, enum snmp_op op)
+{
+	int ret;
+
+	value->syntax = np->syntax;
+	value->v.octetstring.octets = NULL;
+	ret = np->op(&context, value, np->oid.len, np->index, op);
+	if (ret != SNMP_ERR_NOERROR)
+		value->syntax = SNMP_SYNTAX_NULL;
+	return (ret);
+}
+
+/*
+ * Set a column of the row index, or a leaf if index is 0, the way
+ * bsnmpd applies the configuration file.
+ */
+static void
+set(const char *name, u_int index, int32_t integer, const char *str)
+{
+	const struct snmp_node *np;
+	struct snmp_value value;
+	int ret;
+
+	np = node_find(name);
+	memset(&value, 0, sizeof(value));
+	value.var = np->oid;
+	value.var.subs[value.var.len++] = index;
+	value.syntax = np->syntax;
+	if (str != NULL) {
+		value.v.octetstring.octets = (u_char *)(uintptr_t)str;
+		value.v.octetstring.len = strlen(str);
+	} else
+		value.v.integer = integer;
+	ret = np->op(&context, &value, np->oid.len, np->index, SNMP_OP_SET);
+	np->op(&context, &value, np->oid.len, np->index,
+	    ret == SNMP_ERR_NOERROR ? SNMP_OP_COMMIT : SNMP_OP_ROLLBACK);
+	if (ret != SNMP_ERR_NOERROR) {
+		fprintf(stderr, "ucdbench: failed to set %s.%u: %d\n", name,
+		    index, ret);
+		exit(1);
+	}
+}
+
+static void
+configure(void)
+{
+	static const char *names[] = { "httpd", "sshd", "java", "postgres",
+	    "nginx", "cron", "syslogd", "bsnmpd" };
+	char buf[64];
+	int i;
+
+	/* Rescan processes on every check. */
+	set("extUpdateInterval", 0, 100, NULL);
+
+	for (i = 1; i <= npr; i++) {
+		switch (i % 4) {
+		case 0:
+			/* Prefix match. */
+			snprintf(buf, sizeof(buf), "%.3s", names[i % 8]);
+			set("prNames", i, 0, buf);
+			set("prMatch", i, 2, NULL);
+			break;
+		case 1:
+			/* Regular expression. */
+			snprintf(buf, sizeof(buf), "^(%s|%s)$", names[i % 8],
+			    names[(i + 1) % 8]);
+			set("prNames", i, 0, buf);
+			set("prMatch", i, 3, NULL);
+			break;
+		default:
+			set("prNames", i, 0, names[i % 8]);
+			break;
+		}
+		set("prMin", i, 1, NULL);
+	}
+
+	for (i = 1; i <= next; i++) {
+		snprintf(buf, sizeof(buf), "bench%d", i);
+		set("extNames", i, 0, buf);
+		snprintf(buf, sizeof(buf), "echo %d", i);
+		set("extCommand", i, 0, buf);
+	}
+
+	/*
+	 * Plugin rows follow the command rows. They are run only once, so
+	 * extOutputTable does not change while it is measured.
+	 */
+	for (i = next + 1; i <= next + nplugin; i++) {
+		snprintf(buf, sizeof(buf), "plugin%d", i);
+		set("extNames", i, 0, buf);
+		snprintf(buf, sizeof(buf), "%d", nplugin_lines);
+		set("extCommand", i, 0, buf);
+		set("extPlugin", i, 0, BENCH_PLUGIN);
+		set("extInterval", i, INT32_MAX, NULL);
+	}
+}
+
+/*
+ * Handle the plugin results until every plugin row has its output.
+ */
+static void
+plugins_wait(void)
+{
+	const struct snmp_node *np;
+	struct snmp_value value;
+	uint64_t deadline;
+	int i;
+
+	np = node_find("extOutputLines");
+	deadline = now() + (uint64_t)PLUGIN_WAIT * 1000000;
+	for (i = next + 1; i <= next + nplugin; i++) {
+		for (;;) {
+			memset(&value, 0, sizeof(value));
+			value.var = np->oid;
+			value.var.subs[value.var.len++] = i;
+			if (node_op(np, &value, SNMP_OP_GET) ==
+			    SNMP_ERR_NOERROR && value.v.integer > 0)
+				break;
+			if (now() > deadline) {
+				fprintf(stderr, "ucdbench: plugin row %d "
+				    "has no output\n", i);
+				exit(1);
+			}
+			bench_fd_poll(100);
+		}
+	}
+}
+
+static struct handler *
+handler_get(snmp_op_t op)
+{
+	const struct ucd_op *up;
+	u_int i;
+
+	for (i = 0; i < nhandlers; i++)
+		if (handlers[i].op->op == op)
+			return (&handlers[i]);
+	for (up = ucd_ops; up->op != NULL; up++)
+		if (up->op == op)
+			break;
+	handlers = realloc(handlers, (nhandlers + 1) * sizeof(*handlers));
+	if (handlers == NULL || up->op == NULL) {
+		fprintf(stderr, "ucdbench: failed to add handler\n");
+		exit(1);
+	}
+	memset(&handlers[nhandlers], 0, sizeof(*handlers));
+	handlers[nhandlers].op = up;
+	return (&handlers[nhandlers++]);
+}
+
+static void
+handlers_init(void)
+{
+	struct handler *hp;
+	u_int i;
+
+	for (i = 0; i < config.tree_size; i++) {
+		hp = handler_get(config.tree[i].op);
+		hp->nodes = realloc(hp->nodes,
+		    (hp->nnodes + 1) * sizeof(*hp->nodes));
+		if (hp->nodes == NULL) {
+			fprintf(stderr, "ucdbench: out of memory\n");
+			exit(1);
+		}
+		hp->nodes[hp->nnodes++] = &config.tree[i];
+	}
+}
+
+static void
+instance_add(struct handler *hp, const struct snmp_node *np,
+    const struct asn_oid *var)
+{
+
+	if (hp->ninst == hp->ainst) {
+		hp->ainst = hp->ainst ? hp->ainst * 2 : 64;
+		hp->inst = realloc(hp->inst, hp->ainst * sizeof(*hp->inst));
+		if (hp->inst == NULL) {
+			fprintf(stderr, "ucdbench: out of memory\n");
+			exit(1);
+		}
+	}
+	hp->inst[hp->ninst].node = np;
+	hp->inst[hp->ninst].var = *var;
+	hp->ninst++;
+}
+
+/*
+ * Get the next instance of the node after value->var, as bsnmpd does:
+ * a leaf has the only instance .0 that is fetched with GET, columns are
+ * asked for GETNEXT.
+ */
+static int
+node_next(const struct snmp_node *np, struct snmp_value *value)
+{
+
+	if (np->type == SNMP_NODE_LEAF) {
+		if (value->var.len > np->oid.len)
+			return (SNMP_ERR_NOSUCHNAME);
+		value->var = np->oid;
+		value->var.subs[value->var.len++] = 0;
+		return (node_op(np, value, SNMP_OP_GET));
+	}
+	return (node_op(np, value, SNMP_OP_GETNEXT));
+}
+
+/* Walk the nodes of the handler one by one. */
+static void
+bench_getnext(struct handler *hp, int collect)
+{
+	const struct snmp_node *np;
+	struct snmp_value value;
+	uint64_t t, a, n;
+	u_int i;
+
+	n = 0;
+	a = bench_nalloc;
+	t = now();
+	for (i = 0; i < hp->nnodes; i++) {
+		np = hp->nodes[i];
+		value.var = np->oid;
+		while (node_next(np, &value) == SNMP_ERR_NOERROR) {
+			if (collect)
+				instance_add(hp, np, &value.var);
+			value_free(&value);
+			n++;
+		}
+	}
+	hp->res[B_GETNEXT].ns += now() - t;
+	hp->res[B_GETNEXT].allocs += bench_nalloc - a;
+	hp->res[B_GETNEXT].varbinds += n;
+}
+
+/* GET every instance found by the first walk. */
+static void
+bench_get(struct handler *hp)
+{
+	struct snmp_value value;
+	uint64_t t, a, n;
+	u_int i;
+
+	n = 0;
+	a = bench_nalloc;
+	t = now();
+	for (i = 0; i < hp->ninst; i++) {
+		value.var = hp->inst[i].var;
+		if (node_op(hp->inst[i].node, &value, SNMP_OP_GET) ==
+		    SNMP_ERR_NOERROR)
+			value_free(&value);
+		n++;
+	}
+	hp->res[B_GET].ns += now() - t;
+	hp->res[B_GET].allocs += bench_nalloc - a;
+	hp->res[B_GET].varbinds += n;
+}
+
+/*
+ * GETBULK of all nodes of the handler at once, reps repetitions per
+ * request, until every column is exhausted, so the rows of a table are
+ * read column by column in turn.
+ */
+static void
+bench_getbulk(struct handler *hp)
+{
+	struct snmp_value *vb;
+	uint64_t t, a, n;
+	u_int i, active;
+	int r;
+
+	vb = calloc(hp->nnodes, sizeof(*vb));
+	if (vb == NULL) {
+		fprintf(stderr, "ucdbench: out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < hp->nnodes; i++)
+		vb[i].var = hp->nodes[i]->oid;
+
+	n = 0;
+	a = bench_nalloc;
+	t = now();
+	for (active = hp->nnodes; active > 0; ) {
+		for (r = 0; r < reps && active > 0; r++) {
+			for (i = 0; i < hp->nnodes; i++) {
+				if (vb[i].var.len == 0)
+					continue;
+				if (node_next(hp->nodes[i], &vb[i]) !=
+				    SNMP_ERR_NOERROR) {
+					vb[i].var.len = 0;
+					active--;
+					continue;
+				}
+				value_free(&vb[i]);
+				n++;
+			}
+		}
+	}
+	hp->res[B_GETBULK].ns += now() - t;
+	hp->res[B_GETBULK].allocs += bench_nalloc - a;
+	hp->res[B_GETBULK].varbinds += n;
+	free(vb);
+}
+
+struct timer_result {
+	void		(*func)(void *);
+	void		*arg;
+	u_int		period;
+	uint64_t	calls;
+	uint64_t	ns;
+	uint64_t	allocs;
+};
+
+static struct timer_result *timers;
+static u_int ntimers;
+
+static void
+timer_add(void (*func)(void *), void *arg, u_int period, void *ctx __unused)
+{
+
+	timers = realloc(timers, (ntimers + 1) * sizeof(*timers));
+	if (timers == NULL) {
+		fprintf(stderr, "ucdbench: out of memory\n");
+		exit(1);
+	}
+	memset(&timers[ntimers], 0, sizeof(*timers));
+	timers[ntimers].func = func;
+	timers[ntimers].arg = arg;
+	timers[ntimers].period = period;
+	ntimers++;
+}
+
+/* Advance the clock by the timer period and call it. */
+static void
+bench_timers(void)
+{
+	struct timer_result *tp;
+	uint64_t t, a;
+	u_int i;
+
+	for (i = 0; i < ntimers; i++) {
+		tp = &timers[i];
+		bench_ticks += tp->period;
+		a = bench_nalloc;
+		t = now();
+		tp->func(tp->arg);
+		tp->ns += now() - t;
+		tp->allocs += bench_nalloc - a;
+		tp->calls++;
+	}
+}
+
+static double
+ratio(uint64_t a, uint64_t b)
+{
+
+	return (b == 0 ? 0 : (double)a / b);
+}
+
+static void
+report(void)
+{
+	struct handler *hp;
+	struct timer_result *tp;
+	u_int i, op;
+
+	printf("%-20s %-8s %10s %12s %14s\n", "handler", "op", "varbinds",
+	    "ns/varbind", "allocs/varbind");
+	for (i = 0; i < nhandlers; i++) {
+		hp = &handlers[i];
+		for (op = 0; op < B_NOPS; op++)
+			printf("%-20s %-8s %10ju %12.1f %14.2f\n",
+			    hp->op->name, opnames[op],
+			    (uintmax_t)hp->res[op].varbinds,
+			    ratio(hp->res[op].ns, hp->res[op].varbinds),
+			    ratio(hp->res[op].allocs, hp->res[op].varbinds));
+	}
+
+	printf("\n%-20s %-8s %10s %12s %14s\n", "timer", "period", "calls",
+	    "ns/call", "allocs/call");
+	for (i = 0; i < ntimers; i++) {
+		tp = &timers[i];
+		printf("timer%-15u %-8u %10ju %12.1f %14.2f\n", i, tp->period,
+		    (uintmax_t)tp->calls, ratio(tp->ns, tp->calls),
+		    ratio(tp->allocs, tp->calls));
+	}
+	printf("\nsyslog messages: %ju\n", (uintmax_t)bench_nsyslog);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "usage: ucdbench [-v] [-n iterations] [-r repetitions] "
+	    "[-P processes]\n\t[-D disks] [-I iodevices] [-R prrows] "
+	    "[-E extrows]\n\t[-X pluginrows] [-L pluginlines]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	u_int i;
+	int ch, it;
+
+	while ((ch = getopt(argc, argv, "D:E:I:L:n:P:R:r:vX:")) != -1) {
+		switch (ch) {
+		case 'D':
+			bench_config.ndisks = atoi(optarg);
+			break;
+		case 'E':
+			next = atoi(optarg);
+			break;
+		case 'I':
+			bench_config.ndevs = atoi(optarg);
+			break;
+		case 'L':
+			nplugin_lines = atoi(optarg);
+			break;
+		case 'n':
+			niter = atoi(optarg);
+			break;
+		case 'P':
+			bench_config.nprocs = atoi(optarg);
+			break;
+		case 'R':
+			npr = atoi(optarg);
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		case 'v':
+			bench_verbose = 1;
+			break;
+		case 'X':
+			nplugin = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (niter < 1 || reps < 1 || bench_config.nprocs < 0 ||
+	    bench_config.ndisks < 0 || bench_config.ndevs < 0 || npr < 0 ||
+	    next < 0 || nplugin < 0 || nplugin_lines < 1)
+		usage();
+
+	datasrc_init();
+	if (config.init(NULL, 0, NULL) != 0) {
+		fprintf(stderr, "ucdbench: module init failed\n");
+		return (1);
+	}
+	config.start();
+	configure();
+	handlers_init();
+	bench_timers_foreach(timer_add, NULL);
+
+	/* Collect the data once, so tables are populated. */
+	bench_timers();
+	plugins_wait();
+
+	for (it = 0; it < niter; it++) {
+		bench_timers();
+		for (i = 0; i < nhandlers; i++) {
+			bench_getnext(&handlers[i], it == 0);
+			bench_get(&handlers[i]);
+			bench_getbulk(&handlers[i]);
+		}
+	}
+	report();
+
+	config.fini();
+	datasrc_fini();
+	for (i = 0; i < nhandlers; i++) {
+		free(handlers[i].nodes);
+		free(handlers[i].inst);
+	}
+	free(handlers);
+	free(timers);
+	return (0);
+}
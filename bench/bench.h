@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#include <bsnmp/snmpmod.h>
+
+/* ucd_tree.c, generated by gentree. */
+
+struct ucd_op {
+	snmp_op_t	op;
+	const char	*name;
+};
+
+extern const struct ucd_op ucd_ops[];
+
+/* snmpmod.c */
+
+/* Virtual clock returned by get_ticks(), in 1/100 s. */
+extern uint64_t bench_ticks;
+
+/* Number of allocations made by the module and of syslog messages. */
+extern uint64_t bench_nalloc;
+extern uint64_t bench_nsyslog;
+
+/* Print syslog messages of the module to stderr. */
+extern int bench_verbose;
+
+/* Call f for every running repeat timer. */
+extern void bench_timers_foreach(void (*f)(void (*)(void *), void *, u_int,
+    void *), void *);
+
+/*
+ * Wait up to timeout ms for the selected descriptors and call the
+ * handlers of the ready ones, as the bsnmpd main loop does.
+ */
+extern void bench_fd_poll(int timeout);
+
+/* datasrc.c */
+
+/* Sizes of the synthetic data sources. */
+struct bench_config {
+	int	nprocs;		/* Processes. */
+	int	ndisks;		/* Mounted file systems. */
+	int	ndevs;		/* devstat devices. */
+};
+
+extern struct bench_config bench_config;
+
+extern void datasrc_init(void);
+extern void datasrc_fini(void);
+
+/*
+ * extPlugin path of the plugin built into the benchmark. extCommand is
+ * the number of output lines of the plugin.
+ */
+#define BENCH_PLUGIN	"bench"
+
+#endif
@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+/*
+ * Synthetic data sources: the FreeBSD kernel and library interfaces the
+ * module reads its data from, returning tables of the configured size
+ * with counters that advance with the virtual clock.
+ */
+
+#include <sys/param.h>
+#include <sys/mount.h>
+#include <sys/sysctl.h>
+#include <sys/user.h>
+#include <sys/vmmeter.h>
+#include <sys/event.h>
+
+#include <devstat.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <jail.h>
+#include <kvm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ucd_plugin.h"
+#include "bench.h"
+
+struct bench_config bench_config = {
+	.nprocs = 500,
+	.ndisks = 16,
+	.ndevs = 32,
+};
+
+char devstat_errbuf[DEVSTAT_ERRBUF_SIZE];
+
+static const char *comms[] = {
+	"httpd", "sshd", "java", "postgres", "nginx", "cron", "syslogd",
+	"bsnmpd", "sh", "getty",
+};
+#define NCOMMS	(sizeof(comms) / sizeof(comms[0]))
+
+#define PID_BASE	100
+
+static struct kinfo_proc *procs;
+static struct statfs *mounts;
+static struct devstat *devs;
+static int kvm_cookie;
+
+static void
+proc_fill(int i)
+{
+	struct kinfo_proc *kp;
+
+	kp = &procs[i];
+	kp->ki_runtime = (uint64_t)(i % 7 + 1) * 1000 * bench_ticks;
+	kp->ki_pctcpu = (i % 13) * FSCALE / 100;
+}
+
+void
+datasrc_init(void)
+{
+	struct kinfo_proc *kp;
+	struct statfs *sp;
+	struct devstat *dp;
+	int i;
+
+	procs = calloc(bench_config.nprocs, sizeof(*procs));
+	mounts = calloc(bench_config.ndisks, sizeof(*mounts));
+	devs = calloc(bench_config.ndevs, sizeof(*devs));
+	if ((procs == NULL && bench_config.nprocs > 0) ||
+	    (mounts == NULL && bench_config.ndisks > 0) ||
+	    (devs == NULL && bench_config.ndevs > 0)) {
+		fprintf(stderr, "ucdbench: out of memory\n");
+		exit(1);
+	}
+
+	for (i = 0; i < bench_config.nprocs; i++) {
+		kp = &procs[i];
+		kp->ki_structsize = sizeof(*kp);
+		kp->ki_pid = PID_BASE + i;
+		kp->ki_ppid = 1;
+		snprintf(kp->ki_comm, sizeof(kp->ki_comm), "%s",
+		    comms[i % NCOMMS]);
+		kp->ki_rssize = 256 + i % 1024;
+		kp->ki_numthreads = 1 + i % 4;
+		kp->ki_start.tv_sec = i;
+		kp->ki_stat = 3;
+		proc_fill(i);
+	}
+
+	for (i = 0; i < bench_config.ndisks; i++) {
+		sp = &mounts[i];
+		sp->f_bsize = 4096;
+		sp->f_blocks = 1000000 + i * 1000;
+		sp->f_bfree = 400000 + i * 100;
+		sp->f_bavail = 350000 + i * 100;
+		sp->f_files = 500000;
+		sp->f_ffree = 250000;
+		snprintf(sp->f_fstypename, sizeof(sp->f_fstypename), "ufs");
+		snprintf(sp->f_mntfromname, sizeof(sp->f_mntfromname),
+		    "/dev/ada%dp2", i);
+		snprintf(sp->f_mntonname, sizeof(sp->f_mntonname),
+		    i == 0 ? "/" : "/mnt/bench%d", i);
+	}
+
+	for (i = 0; i < bench_config.ndevs; i++) {
+		dp = &devs[i];
+		dp->allocated = 1;
+		dp->device_number = i;
+		snprintf(dp->device_name, sizeof(dp->device_name), "%s",
+		    i % 2 ? "da" : "ada");
+		dp->unit_number = i / 2;
+		dp->block_size = 512;
+		dp->device_type = DEVSTAT_TYPE_DIRECT | DEVSTAT_TYPE_IF_SCSI;
+		dp->priority = i;
+	}
+}
+
+void
+datasrc_fini(void)
+{
+
+	free(procs);
+	free(mounts);
+	free(devs);
+}
+
+static struct kinfo_proc *
+proc_find(int pid)
+{
+	int i;
+
+	i = pid - PID_BASE;
+	if (i < 0 || i >= bench_config.nprocs)
+		return (NULL);
+	proc_fill(i);
+	return (&procs[i]);
+}
+
+static int
+sysctl_out(void *old, size_t *oldlenp, const void *data, size_t len)
+{
+
+	if (old == NULL) {
+		*oldlenp = len;
+		return (0);
+	}
+	if (*oldlenp < len) {
+		memcpy(old, data, *oldlenp);
+		errno = ENOMEM;
+		return (-1);
+	}
+	memcpy(old, data, len);
+	*oldlenp = len;
+	return (0);
+}
+
+int
+sysctl(const int *mib, u_int len, void *old, size_t *oldlenp,
+    const void *new __unused, size_t newlen __unused)
+{
+	struct kinfo_proc *kp;
+	char args[64];
+	int i, n;
+
+	if (len < 3 || mib[0] != CTL_KERN || mib[1] != KERN_PROC) {
+		errno = ENOENT;
+		return (-1);
+	}
+	if (mib[2] == KERN_PROC_PROC) {
+		for (i = 0; i < bench_config.nprocs; i++)
+			proc_fill(i);
+		return (sysctl_out(old, oldlenp, procs,
+		    bench_config.nprocs * sizeof(*procs)));
+	}
+	if (len != 4 || (kp = proc_find(mib[3])) == NULL) {
+		errno = ESRCH;
+		return (-1);
+	}
+	switch (mib[2]) {
+	case KERN_PROC_PID:
+		return (sysctl_out(old, oldlenp, kp, sizeof(*kp)));
+	case KERN_PROC_ARGS:
+		n = snprintf(args, sizeof(args), "/usr/local/bin/%s%c-c%c"
+		    "/usr/local/etc/%s.conf", kp->ki_comm, '\0', '\0',
+		    kp->ki_comm);
+		return (sysctl_out(old, oldlenp, args, n + 1));
+	case KERN_PROC_NFDS:
+		n = 8 + kp->ki_pid % 32;
+		return (sysctl_out(old, oldlenp, &n, sizeof(n)));
+	default:
+		errno = ENOENT;
+		return (-1);
+	}
+}
+
+int
+sysctlbyname(const char *name, void *old, size_t *oldlenp,
+    const void *new __unused, size_t newlen __unused)
+{
+	struct vmtotal total;
+	long cp_time[CPUSTATES];
+	u_long val;
+
+	if (strcmp(name, "kern.cp_time") == 0) {
+		cp_time[CP_USER] = bench_ticks * 20;
+		cp_time[CP_NICE] = bench_ticks;
+		cp_time[CP_SYS] = bench_ticks * 10;
+		cp_time[CP_INTR] = bench_ticks * 2;
+		cp_time[CP_IDLE] = bench_ticks * 67;
+		return (sysctl_out(old, oldlenp, cp_time, sizeof(cp_time)));
+	}
+	if (strcmp(name, "vm.vmtotal") == 0) {
+		memset(&total, 0, sizeof(total));
+		total.t_vmshr = 10000;
+		total.t_avmshr = 5000;
+		total.t_rmshr = 8000;
+		total.t_armshr = 4000;
+		total.t_free = 100000;
+		return (sysctl_out(old, oldlenp, &total, sizeof(total)));
+	}
+	if (strcmp(name, "hw.physmem") == 0)
+		val = 8UL << 30;
+	else if (strncmp(name, "vm.stats.", 9) == 0)
+		val = 1000 + bench_ticks * 7;
+	else if (strcmp(name, "vfs.bufspace") == 0)
+		val = 64UL << 20;
+	else {
+		errno = ENOENT;
+		return (-1);
+	}
+	return (sysctl_out(old, oldlenp, &val, sizeof(val)));
+}
+
+int
+getmntinfo(struct statfs **mntbufp, int mode __unused)
+{
+
+	*mntbufp = mounts;
+	return (bench_config.ndisks);
+}
+
+static void
+dev_fill(struct devstat *dp)
+{
+	uint64_t n;
+
+	n = bench_ticks * (dp->device_number + 1);
+	dp->sequence0++;
+	dp->bytes[DEVSTAT_READ] = n * 4096;
+	dp->bytes[DEVSTAT_WRITE] = n * 8192;
+	dp->operations[DEVSTAT_READ] = n;
+	dp->operations[DEVSTAT_WRITE] = n * 2;
+	dp->busy_time.sec = bench_ticks / 200;
+	dp->sequence1 = dp->sequence0;
+}
+
+int
+devstat_checkversion(void *kd __unused)
+{
+
+	return (0);
+}
+
+int
+devstat_getnumdevs(void *kd __unused)
+{
+
+	return (bench_config.ndevs);
+}
+
+long
+devstat_getgeneration(void *kd __unused)
+{
+
+	return (1);
+}
+
+int
+devstat_getdevs(void *kd __unused, struct statinfo *stats)
+{
+	int i;
+
+	for (i = 0; i < bench_config.ndevs; i++)
+		dev_fill(&devs[i]);
+	stats->dinfo->devices = devs;
+	stats->dinfo->numdevs = bench_config.ndevs;
+	if (stats->dinfo->generation == 1)
+		return (0);
+	stats->dinfo->generation = 1;
+	return (1);
+}
+
+int
+devstat_buildmatch(char *match __unused, struct devstat_match **matches
+    __unused, int *num_matches __unused)
+{
+
+	snprintf(devstat_errbuf, sizeof(devstat_errbuf),
+	    "match expressions are not supported by the benchmark");
+	return (-1);
+}
+
+kvm_t *
+kvm_open(const char *uf __unused, const char *mf __unused,
+    const char *sf __unused, int flag __unused, const char *errout __unused)
+{
+
+	return ((kvm_t *)&kvm_cookie);
+}
+
+int
+kvm_close(kvm_t *kd __unused)
+{
+
+	return (0);
+}
+
+int
+kvm_getswapinfo(kvm_t *kd __unused, struct kvm_swap *swap, int maxswap,
+    int flags __unused)
+{
+
+	if (maxswap < 1)
+		return (0);
+	memset(swap, 0, sizeof(*swap));
+	snprintf(swap->ksw_devname, sizeof(swap->ksw_devname), "ada0p3");
+	swap->ksw_total = 1 << 20;
+	swap->ksw_used = 1 << 16;
+	return (1);
+}
+
+int
+jail_getid(const char *name __unused)
+{
+
+	errno = ENOENT;
+	return (-1);
+}
+
+char *
+jail_getname(int jid __unused)
+{
+
+	errno = ENOENT;
+	return (NULL);
+}
+
+/*
+ * kqueue that never reports an event: synthetic processes neither exit nor
+ * fork, so prTable is refreshed from its watches between the full scans.
+ */
+
+int
+kqueue(void)
+{
+	int fds[2];
+
+	if (pipe(fds) == -1)
+		return (-1);
+	return (fds[0]);	/* The write end stays open. */
+}
+
+int
+kevent(int kq __unused, const struct kevent *changes, int nchanges,
+    struct kevent *events __unused, int nevents __unused,
+    const struct timespec *timeout __unused)
+{
+	int i;
+
+	for (i = 0; i < nchanges; i++) {
+		if (changes[i].filter == EVFILT_PROC &&
+		    (changes[i].flags & EV_ADD) != 0 &&
+		    proc_find(changes[i].ident) == NULL) {
+			errno = ESRCH;
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Commands are not started, extTable rows with commands measure the
+ * failure path. Rows with the built-in plugin produce output.
+ */
+
+pid_t
+bench_vfork(void)
+{
+
+	errno = EAGAIN;
+	return (-1);
+}
+
+/* Plugin built into the benchmark, printing extCommand lines. */
+
+static int
+bench_plugin_init(const char *args, void **ctxp)
+{
+
+	*ctxp = (void *)(intptr_t)atoi(args);
+	return (0);
+}
+
+static int
+bench_plugin_run(void *ctx, char *buf, size_t size)
+{
+	size_t len;
+	int i, n;
+
+	n = (int)(intptr_t)ctx;
+	buf[0] = '\0';
+	for (i = 1, len = 0; i <= n && len < size; i++)
+		len += snprintf(buf + len, size - len, "bench line %d of %d\n",
+		    i, n);
+	return (0);
+}
+
+static const struct ucd_plugin bench_plugin = {
+	.abi = UCD_PLUGIN_ABI,
+	.init = bench_plugin_init,
+	.run = bench_plugin_run,
+};
+
+void *
+bench_dlopen(const char *path, int mode)
+{
+
+	if (strcmp(path, BENCH_PLUGIN) == 0)
+		return (__DECONST(void *, &bench_plugin));
+	return (dlopen(path, mode));
+}
+
+void *
+bench_dlsym(void *handle, const char *symbol)
+{
+
+	if (handle == &bench_plugin)
+		return (strcmp(symbol, UCD_PLUGIN_SYMBOL) == 0 ? handle : NULL);
+	return (dlsym(handle, symbol));
+}
+
+int
+bench_dlclose(void *handle)
+{
+
+	if (handle == &bench_plugin)
+		return (0);
+	return (dlclose(handle));
+}
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+/*
+ * Minimal replacement of gensnmptree(1) for building the benchmark on
+ * systems without bsnmp. Reads MIB tree definitions on stdin, merging
+ * them as gensnmptree does, and writes
+ * <prefix>tree.h, <prefix>oid.h and <prefix>tree.c to the current
+ * directory. Only the constructs used by ucd_tree.def are supported:
+ * leaves "(num name SYNTAX op [GET] [SET])", table entries
+ * "(num name : INDEX... op (columns))" and plain subtrees.
+ */
+
+#include <ctype.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAXDEPTH	32
+#define MAXTOK		128
+
+enum { NODE_TREE, NODE_LEAF, NODE_ENTRY, NODE_COLUMN };
+
+struct node {
+	int		type;
+	unsigned	oid[MAXDEPTH];
+	int		len;
+	char		name[MAXTOK];
+	char		syntax[MAXTOK];
+	char		op[MAXTOK];
+	int		canset;
+	int		nindex;
+};
+
+static struct node *nodes;		/* In the order of definition. */
+static int nnodes, anodes;
+
+static FILE *in;
+static int lineno = 1;
+
+/* Read the next token: "(", ")", ":" or a word. Returns 0 on EOF. */
+static int
+token(char *buf)
+{
+	int c, n;
+
+	for (;;) {
+		c = getc(in);
+		if (c == '\n')
+			lineno++;
+		if (c == '#') {
+			while ((c = getc(in)) != EOF && c != '\n')
+				;
+			lineno++;
+		}
+		if (c == EOF)
+			return (0);
+		if (!isspace(c))
+			break;
+	}
+	if (c == '(' || c == ')' || c == ':') {
+		buf[0] = c;
+		buf[1] = '\0';
+		return (1);
+	}
+	n = 0;
+	do {
+		if (n == MAXTOK - 1)
+			errx(1, "line %d: token too long", lineno);
+		buf[n++] = c;
+		c = getc(in);
+	} while (c != EOF && !isspace(c) && c != '(' && c != ')' &&
+	    c != ':' && c != '#');
+	ungetc(c, in);
+	buf[n] = '\0';
+	return (1);
+}
+
+static struct node *
+node_add(void)
+{
+
+	if (nnodes == anodes) {
+		anodes = anodes ? anodes * 2 : 64;
+		nodes = realloc(nodes, anodes * sizeof(*nodes));
+		if (nodes == NULL)
+			err(1, "realloc");
+	}
+	memset(&nodes[nnodes], 0, sizeof(nodes[nnodes]));
+	return (&nodes[nnodes++]);
+}
+
+/*
+ * Parse a node whose "(" has been read. The parent is given by its index in
+ * nodes, or -1 for the root.
+ */
+static void
+parse_node(int parent)
+{
+	struct node *np, *pp;
+	char tok[MAXTOK];
+	int i, idx;
+
+	idx = nnodes;
+	np = node_add();
+	if (parent >= 0) {
+		pp = &nodes[parent];
+		if (pp->len == MAXDEPTH)
+			errx(1, "line %d: tree too deep", lineno);
+		memcpy(np->oid, pp->oid, pp->len * sizeof(*pp->oid));
+		np->len = pp->len;
+		if (pp->type == NODE_ENTRY) {
+			np->type = NODE_COLUMN;
+			strcpy(np->op, pp->op);
+			np->nindex = pp->nindex;
+		}
+	}
+	np->len++;
+	if (!token(tok))
+		errx(1, "line %d: unexpected EOF", lineno);
+	np->oid[np->len - 1] = strtoul(tok, NULL, 10);
+	if (!token(np->name))
+		errx(1, "line %d: unexpected EOF", lineno);
+
+	/* Merge with the same node of a tree read before. */
+	for (i = 0; i < idx; i++) {
+		if (nodes[i].len == np->len &&
+		    memcmp(nodes[i].oid, np->oid,
+		    np->len * sizeof(*np->oid)) == 0) {
+			if (strcmp(nodes[i].name, np->name) != 0)
+				errx(1, "line %d: %s conflicts with %s",
+				    lineno, np->name, nodes[i].name);
+			nnodes--;
+			idx = i;
+			break;
+		}
+	}
+
+	while (token(tok)) {
+		if (strcmp(tok, ")") == 0)
+			return;
+		if (strcmp(tok, "(") == 0) {
+			parse_node(idx);
+			continue;
+		}
+		np = &nodes[idx];
+		if (strcmp(tok, ":") == 0) {
+			np->type = NODE_ENTRY;
+		} else if (strncmp(tok, "op_", 3) == 0) {
+			strcpy(np->op, tok);
+			if (np->type == NODE_TREE)
+				np->type = NODE_LEAF;
+		} else if (strcmp(tok, "GET") == 0) {
+			;
+		} else if (strcmp(tok, "SET") == 0) {
+			np->canset = 1;
+		} else if (np->type == NODE_ENTRY) {
+			np->nindex++;
+		} else {
+			strcpy(np->syntax, tok);
+		}
+	}
+	errx(1, "line %d: unexpected EOF", lineno);
+}
+
+/* Node i is a leaf or an entry with an op not seen before. */
+static int
+is_first_op(int i)
+{
+	int j;
+
+	if (nodes[i].type != NODE_LEAF && nodes[i].type != NODE_ENTRY)
+		return (0);
+	for (j = 0; j < i; j++)
+		if ((nodes[j].type == NODE_LEAF ||
+		    nodes[j].type == NODE_ENTRY) &&
+		    strcmp(nodes[j].op, nodes[i].op) == 0)
+			return (0);
+	return (1);
+}
+
+static const char *
+syntax(const char *s)
+{
+
+	if (strcmp(s, "INTEGER") == 0 || strcmp(s, "INTEGER32") == 0)
+		return ("SNMP_SYNTAX_INTEGER");
+	if (strcmp(s, "OCTETSTRING") == 0)
+		return ("SNMP_SYNTAX_OCTETSTRING");
+	if (strcmp(s, "OID") == 0)
+		return ("SNMP_SYNTAX_OID");
+	if (strcmp(s, "COUNTER") == 0)
+		return ("SNMP_SYNTAX_COUNTER");
+	if (strcmp(s, "UNSIGNED32") == 0 || strcmp(s, "GAUGE") == 0)
+		return ("SNMP_SYNTAX_GAUGE");
+	if (strcmp(s, "TIMETICKS") == 0)
+		return ("SNMP_SYNTAX_TIMETICKS");
+	if (strcmp(s, "COUNTER64") == 0)
+		return ("SNMP_SYNTAX_COUNTER64");
+	errx(1, "unknown syntax %s", s);
+}
+
+static void
+print_oid(FILE *fp, const struct node *np)
+{
+	int i;
+
+	fprintf(fp, "{ %d, { 1, 3, 6", np->len + 3);
+	for (i = 0; i < np->len; i++)
+		fprintf(fp, ", %u", np->oid[i]);
+	fprintf(fp, " } }");
+}
+
+static int
+oidcmp(const void *a, const void *b)
+{
+	const struct node *n1, *n2;
+	int i;
+
+	n1 = *(const struct node * const *)a;
+	n2 = *(const struct node * const *)b;
+	for (i = 0; i < n1->len && i < n2->len; i++)
+		if (n1->oid[i] != n2->oid[i])
+			return (n1->oid[i] < n2->oid[i] ? -1 : 1);
+	return (n1->len - n2->len);
+}
+
+static FILE *
+create(const char *prefix, const char *suffix)
+{
+	char path[256];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s%s", prefix, suffix);
+	if ((fp = fopen(path, "w")) == NULL)
+		err(1, "%s", path);
+	fprintf(fp, "/* Generated by gentree from the tree definition. */\n\n");
+	return (fp);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct node *np, **sorted;
+	const char *prefix;
+	char tok[MAXTOK];
+	FILE *fp;
+	int i, n;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: gentree prefix < tree.def\n");
+		return (1);
+	}
+	prefix = argv[1];
+	in = stdin;
+
+	/* The definition starts at 1.3.6. */
+	while (token(tok)) {
+		if (strcmp(tok, "(") != 0)
+			errx(1, "line %d: '(' expected", lineno);
+		parse_node(-1);
+	}
+
+	fp = create(prefix, "tree.h");
+	fprintf(fp, "#ifndef %sTREE_H\n#define %sTREE_H\n\n", prefix, prefix);
+	for (i = 0; i < nnodes; i++)
+		fprintf(fp, "#define LEAF_%s %u\n", nodes[i].name,
+		    nodes[i].oid[nodes[i].len - 1]);
+	fprintf(fp, "\n");
+	for (i = 0; i < nnodes; i++)
+		if (is_first_op(i))
+			fprintf(fp, "int %s(struct snmp_context *, "
+			    "struct snmp_value *, u_int, u_int, "
+			    "enum snmp_op);\n", nodes[i].op);
+	n = 0;
+	for (i = 0; i < nnodes; i++)
+		if (nodes[i].type == NODE_LEAF || nodes[i].type == NODE_COLUMN)
+			n++;
+	fprintf(fp, "\nextern const struct snmp_node %sctree[];\n", prefix);
+
+	fprintf(fp, "#define %sCTREE_SIZE %d\n\n#endif\n", prefix, n);
+	fclose(fp);
+
+	fp = create(prefix, "oid.h");
+	for (i = 0; i < nnodes; i++) {
+		fprintf(fp, "#define OIDX_%s ", nodes[i].name);
+		print_oid(fp, &nodes[i]);
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+
+	fp = create(prefix, "tree.c");
+	fprintf(fp, "#include <bsnmp/snmpmod.h>\n\n#include \"%stree.h\"\n\n",
+	    prefix);
+	fprintf(fp, "const struct snmp_node %sctree[] = {\n", prefix);
+	sorted = malloc(nnodes * sizeof(*sorted));
+	if (sorted == NULL)
+		err(1, "malloc");
+	for (i = 0; i < nnodes; i++)
+		sorted[i] = &nodes[i];
+	qsort(sorted, nnodes, sizeof(*sorted), oidcmp);
+	for (i = 0; i < nnodes; i++) {
+		np = sorted[i];
+		if (np->type != NODE_LEAF && np->type != NODE_COLUMN)
+			continue;
+		fprintf(fp, "\t{ ");
+		print_oid(fp, np);
+		fprintf(fp, ", \"%s\", %s, %s, %s, %s, %d, NULL, NULL },\n",
+		    np->name, np->type == NODE_LEAF ? "SNMP_NODE_LEAF" :
+		    "SNMP_NODE_COLUMN", syntax(np->syntax), np->op,
+		    np->canset ? "SNMP_NODE_CANSET" : "0",
+		    np->nindex);
+	}
+	fprintf(fp, "};\n\n/* Handlers by name. */\n");
+	fprintf(fp, "struct %sop {\n\tsnmp_op_t\top;\n\tconst char\t*name;"
+	    "\n};\n\n", prefix);
+	fprintf(fp, "extern const struct %sop %sops[];\n\n", prefix, prefix);
+	fprintf(fp, "const struct %sop %sops[] = {\n", prefix, prefix);
+	for (i = 0; i < nnodes; i++) {
+		if (!is_first_op(i))
+			continue;
+		fprintf(fp, "\t{ %s, \"%s\" },\n", nodes[i].op, nodes[i].op);
+	}
+	fprintf(fp, "\t{ NULL, NULL }\n};\n");
+	fclose(fp);
+	free(sorted);
+
+	return (0);
+}
@@ -0,0 +1,806 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+/*
+ * SNMP load generator for bsnmpd with the ucd module.
+ *
+ * Starts bsnmpd on a loopback port with the module loaded (or uses a
+ * running agent) and replays a polling mix from many simulated managers
+ * at the target rate: scalar GETs, GETBULKs of dskTable and diskIOTable
+ * and full ucdavis walks. Every manager is a thread with its own socket
+ * sending on an open-loop schedule, so a stalled agent shows up as
+ * latency measured from the scheduled start instead of a lower request
+ * rate. Throughput, latency percentiles and a per-interval latency series
+ * (to see the module collectors interfering) are reported at the end.
+ */
+
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <bsnmp/asn1.h>
+#include <bsnmp/snmp.h>
+
+#include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Polling operations. */
+enum {
+	LOAD_GET,	/* Scalar GET. */
+	LOAD_BULK,	/* GETBULKs of dskTable or diskIOTable. */
+	LOAD_WALK,	/* GETBULK walk of ucdavis. */
+	LOAD_NOPS
+};
+
+static const char *load_names[LOAD_NOPS] = { "get", "bulk", "walk" };
+
+/* Latency sample. */
+struct sample {
+	uint64_t	t;		/* Completion time, ns since start. */
+	uint32_t	us;		/* Latency, us. */
+	uint8_t		op;
+	uint8_t		pdu;		/* PDU round trip, or operation. */
+};
+
+struct manager {
+	pthread_t	thread;
+	int		s;		/* Socket connected to the agent. */
+	int32_t		reqid;
+	uint64_t	rnd;		/* xorshift state. */
+	struct sample	*samples;
+	size_t		nsamples;
+	size_t		asamples;
+	uint64_t	ops[LOAD_NOPS];
+	uint64_t	pdus;
+	uint64_t	timeouts;
+	uint64_t	errors;
+};
+
+static const struct asn_oid oid_ucdavis = { 7, { 1, 3, 6, 1, 4, 1, 2021 } };
+
+/*
+ * Scalars asked by a LOAD_GET, as a dashboard poller does: laLoadInt.1-3,
+ * memAvailSwap, memTotalReal, memAvailReal and ssCpuIdle.
+ */
+static const struct asn_oid oid_get[] = {
+	{ 11, { 1, 3, 6, 1, 4, 1, 2021, 10, 1, 5, 1 } },
+	{ 11, { 1, 3, 6, 1, 4, 1, 2021, 10, 1, 5, 2 } },
+	{ 11, { 1, 3, 6, 1, 4, 1, 2021, 10, 1, 5, 3 } },
+	{ 10, { 1, 3, 6, 1, 4, 1, 2021, 4, 4, 0 } },
+	{ 10, { 1, 3, 6, 1, 4, 1, 2021, 4, 5, 0 } },
+	{ 10, { 1, 3, 6, 1, 4, 1, 2021, 4, 6, 0 } },
+	{ 10, { 1, 3, 6, 1, 4, 1, 2021, 11, 11, 0 } },
+};
+
+/* Index of memTotalReal in oid_get, used to probe the agent. */
+#define OID_GET_PROBE	4
+
+/* Columns walked by a LOAD_BULK: dskPath, dskAvail, dskPercent. */
+static const struct asn_oid oid_dsk[] = {
+	{ 10, { 1, 3, 6, 1, 4, 1, 2021, 9, 1, 2 } },
+	{ 10, { 1, 3, 6, 1, 4, 1, 2021, 9, 1, 7 } },
+	{ 10, { 1, 3, 6, 1, 4, 1, 2021, 9, 1, 9 } },
+};
+
+/* diskIODevice, diskIONReadX, diskIONWrittenX, diskIOBusy. */
+static const struct asn_oid oid_dio[] = {
+	{ 12, { 1, 3, 6, 1, 4, 1, 2021, 13, 15, 1, 1, 2 } },
+	{ 12, { 1, 3, 6, 1, 4, 1, 2021, 13, 15, 1, 1, 12 } },
+	{ 12, { 1, 3, 6, 1, 4, 1, 2021, 13, 15, 1, 1, 13 } },
+	{ 12, { 1, 3, 6, 1, 4, 1, 2021, 13, 15, 1, 1, 25 } },
+};
+
+/* Max size of SNMP messages over UDP. */
+#define LOAD_MSGSIZE	65536
+
+#define NELEM(a)	(sizeof(a) / sizeof((a)[0]))
+
+/* Options. */
+static const char *agent;		/* Running agent, host:port. */
+static const char *bsnmpd = "/usr/sbin/bsnmpd";
+static const char *module = "/usr/local/lib/snmp_ucd.so";
+static const char *extra_config;
+static const char *community = "public";
+static u_int duration = 10;		/* Seconds. */
+static u_int interval = 1;		/* Report interval, seconds. */
+static u_int nmanagers = 50;
+static u_int port = 16161;
+static u_int maxrep = 10;
+static double rate = 500;		/* Operations per second. */
+static u_int timeout = 1000;		/* ms. */
+static u_int mix[LOAD_NOPS] = { 80, 15, 5 };
+
+static struct sockaddr_in agent_addr;
+static struct manager *managers;
+static uint64_t start_ns;
+static volatile sig_atomic_t stop;
+
+/* Temporary bsnmpd files. */
+static char tmpdir[] = "/tmp/ucdload.XXXXXX";
+static char config_path[64], pid_path[64];
+static pid_t agent_pid = -1;
+
+static uint64_t
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void
+sleep_until(uint64_t t)
+{
+	struct timespec ts;
+	uint64_t cur;
+
+	cur = now();
+	if (t <= cur)
+		return;
+	ts.tv_sec = (t - cur) / 1000000000;
+	ts.tv_nsec = (t - cur) % 1000000000;
+	nanosleep(&ts, NULL);
+}
+
+static uint64_t
+random_next(struct manager *mp)
+{
+
+	mp->rnd ^= mp->rnd << 13;
+	mp->rnd ^= mp->rnd >> 7;
+	mp->rnd ^= mp->rnd << 17;
+	return (mp->rnd);
+}
+
+static void
+sample_add(struct manager *mp, u_int op, int pdu, uint64_t begin,
+    uint64_t end)
+{
+	struct sample *sp;
+
+	if (mp->nsamples == mp->asamples) {
+		mp->asamples = mp->asamples ? mp->asamples * 2 : 1024;
+		sp = realloc(mp->samples, mp->asamples * sizeof(*sp));
+		if (sp == NULL)
+			err(1, "realloc");
+		mp->samples = sp;
+	}
+	sp = &mp->samples[mp->nsamples++];
+	sp->t = end - start_ns;
+	sp->us = (end - begin) / 1000;
+	sp->op = op;
+	sp->pdu = pdu;
+}
+
+static int
+manager_socket(void)
+{
+	int s;
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	if (s == -1)
+		err(1, "socket");
+	if (connect(s, (struct sockaddr *)&agent_addr,
+	    sizeof(agent_addr)) == -1)
+		err(1, "connect");
+	return (s);
+}
+
+/*
+ * Send the request and wait for the response with the same request id.
+ * Returns 0 on success, -1 on timeout.
+ */
+static int
+pdu_dialog(struct manager *mp, struct snmp_pdu *req, struct snmp_pdu *resp)
+{
+	u_char buf[LOAD_MSGSIZE];
+	struct asn_buf b;
+	struct pollfd pfd;
+	uint64_t deadline, cur;
+	ssize_t n;
+	int32_t ip;
+
+	req->request_id = ++mp->reqid;
+	b.asn_ptr = buf;
+	b.asn_len = sizeof(buf);
+	if (snmp_pdu_encode(req, &b) != SNMP_CODE_OK)
+		errx(1, "failed to encode PDU");
+	if (send(mp->s, buf, b.asn_ptr - buf, 0) == -1) {
+		mp->errors++;
+		return (-1);
+	}
+	mp->pdus++;
+
+	deadline = now() + (uint64_t)timeout * 1000000;
+	pfd.fd = mp->s;
+	pfd.events = POLLIN;
+	for (;;) {
+		cur = now();
+		if (cur >= deadline ||
+		    poll(&pfd, 1, (deadline - cur) / 1000000 + 1) <= 0) {
+			mp->timeouts++;
+			return (-1);
+		}
+		n = recv(mp->s, buf, sizeof(buf), 0);
+		if (n == -1) {
+			if (errno != ECONNREFUSED)
+				continue;
+			mp->errors++;
+			return (-1);
+		}
+		b.asn_cptr = buf;
+		b.asn_len = n;
+		memset(resp, 0, sizeof(*resp));
+		if (snmp_pdu_decode(&b, resp, &ip) != SNMP_CODE_OK)
+			continue;
+		if (resp->request_id == req->request_id)
+			break;
+		/* Response to a request that has timed out. */
+		snmp_pdu_free(resp);
+	}
+	if (resp->error_status != SNMP_ERR_NOERROR)
+		mp->errors++;
+	return (0);
+}
+
+static void
+pdu_init(struct snmp_pdu *pdu, u_int type)
+{
+
+	memset(pdu, 0, sizeof(*pdu));
+	pdu->version = SNMP_V2c;
+	pdu->type = type;
+	strlcpy(pdu->community, community, sizeof(pdu->community));
+}
+
+static void
+pdu_add(struct snmp_pdu *pdu, const struct asn_oid *oid)
+{
+
+	pdu->bindings[pdu->nbindings].var = *oid;
+	pdu->bindings[pdu->nbindings].syntax = SNMP_SYNTAX_NULL;
+	pdu->nbindings++;
+}
+
+static void
+do_get(struct manager *mp)
+{
+	struct snmp_pdu req, resp;
+	uint64_t t;
+	u_int i;
+
+	pdu_init(&req, SNMP_PDU_GET);
+	for (i = 0; i < NELEM(oid_get); i++)
+		pdu_add(&req, &oid_get[i]);
+	t = now();
+	if (pdu_dialog(mp, &req, &resp) == 0) {
+		sample_add(mp, LOAD_GET, 1, t, now());
+		snmp_pdu_free(&resp);
+	}
+}
+
+/*
+ * Walk the columns with GETBULKs until every column is exhausted in the
+ * last row returned, as snmptable and bulk pollers do.
+ */
+static void
+walk_columns(struct manager *mp, u_int op, const struct asn_oid *cols,
+    u_int ncols)
+{
+	struct snmp_pdu req, resp;
+	struct asn_oid next[SNMP_MAX_BINDINGS];
+	const struct snmp_value *vp;
+	uint64_t t;
+	u_int i, n, reps, done;
+
+	reps = MIN(maxrep, SNMP_MAX_BINDINGS / ncols);
+	for (i = 0; i < ncols; i++)
+		next[i] = cols[i];
+	for (;;) {
+		pdu_init(&req, SNMP_PDU_GETBULK);
+		req.error_status = 0;		/* non-repeaters */
+		req.error_index = reps;		/* max-repetitions */
+		for (i = 0; i < ncols; i++)
+			pdu_add(&req, &next[i]);
+		t = now();
+		if (pdu_dialog(mp, &req, &resp) == -1)
+			return;
+		sample_add(mp, op, 1, t, now());
+		if (resp.error_status != SNMP_ERR_NOERROR ||
+		    resp.nbindings < ncols) {
+			snmp_pdu_free(&resp);
+			return;
+		}
+		/* The last complete row. */
+		n = resp.nbindings - resp.nbindings % ncols - ncols;
+		done = 0;
+		for (i = 0; i < ncols; i++) {
+			vp = &resp.bindings[n + i];
+			if (vp->syntax == SNMP_SYNTAX_ENDOFMIBVIEW ||
+			    !asn_is_suboid(&cols[i], &vp->var))
+				done = 1;
+			next[i] = vp->var;
+		}
+		snmp_pdu_free(&resp);
+		if (done)
+			return;
+	}
+}
+
+static void
+do_bulk(struct manager *mp)
+{
+
+	if (random_next(mp) % 2)
+		walk_columns(mp, LOAD_BULK, oid_dsk, NELEM(oid_dsk));
+	else
+		walk_columns(mp, LOAD_BULK, oid_dio, NELEM(oid_dio));
+}
+
+static void
+do_walk(struct manager *mp)
+{
+
+	walk_columns(mp, LOAD_WALK, &oid_ucdavis, 1);
+}
+
+static void *
+manager_main(void *arg)
+{
+	struct manager *mp;
+	uint64_t period, next, end, t;
+	u_int op, r, total;
+
+	mp = arg;
+	total = mix[LOAD_GET] + mix[LOAD_BULK] + mix[LOAD_WALK];
+	period = 1e9 * nmanagers / rate;
+	if (period == 0)
+		period = 1;
+	end = start_ns + (uint64_t)duration * 1000000000;
+	/* Spread the managers over the period. */
+	next = start_ns + random_next(mp) % period;
+
+	while (!stop && next < end) {
+		sleep_until(next);
+		r = random_next(mp) % total;
+		for (op = 0; r >= mix[op]; op++)
+			r -= mix[op];
+		switch (op) {
+		case LOAD_GET:
+			do_get(mp);
+			break;
+		case LOAD_BULK:
+			do_bulk(mp);
+			break;
+		case LOAD_WALK:
+			do_walk(mp);
+			break;
+		}
+		t = now();
+		/* Latency of the operation from its scheduled start. */
+		sample_add(mp, op, 0, next, t);
+		mp->ops[op]++;
+		next += period;
+	}
+	return (NULL);
+}
+
+static int
+cmp_u32(const void *a, const void *b)
+{
+	uint32_t x, y;
+
+	x = *(const uint32_t *)a;
+	y = *(const uint32_t *)b;
+	return (x < y ? -1 : x > y);
+}
+
+static uint32_t
+percentile(const uint32_t *v, size_t n, double p)
+{
+	size_t i;
+
+	if (n == 0)
+		return (0);
+	i = p * n;
+	return (v[i < n ? i : n - 1]);
+}
+
+/* Print percentiles of the samples matching op (LOAD_NOPS for all). */
+static void
+print_latency(const char *name, u_int op, int pdu)
+{
+	struct manager *mp;
+	uint32_t *v;
+	size_t n, i;
+	u_int m;
+
+	n = 0;
+	for (m = 0; m < nmanagers; m++)
+		n += managers[m].nsamples;
+	v = malloc((n + 1) * sizeof(*v));
+	if (v == NULL)
+		err(1, "malloc");
+	n = 0;
+	for (m = 0; m < nmanagers; m++) {
+		mp = &managers[m];
+		for (i = 0; i < mp->nsamples; i++)
+			if (mp->samples[i].pdu == pdu &&
+			    (op == LOAD_NOPS || mp->samples[i].op == op))
+				v[n++] = mp->samples[i].us;
+	}
+	qsort(v, n, sizeof(*v), cmp_u32);
+	printf("%-6s %-4s %10zu %9u %9u %9u %9u\n", name,
+	    pdu ? "pdu" : "op", n, percentile(v, n, 0.5),
+	    percentile(v, n, 0.99), percentile(v, n, 0.999),
+	    n > 0 ? v[n - 1] : 0);
+	free(v);
+}
+
+/*
+ * Latency of PDUs completed in every interval. Spikes repeating with the
+ * update or ext check interval are the module collectors blocking
+ * request processing.
+ */
+static void
+print_series(void)
+{
+	struct manager *mp;
+	uint32_t **v;
+	size_t *n, *a, i;
+	u_int m, k, nint;
+
+	nint = (duration + interval - 1) / interval + 1;
+	v = calloc(nint, sizeof(*v));
+	n = calloc(nint, sizeof(*n));
+	a = calloc(nint, sizeof(*a));
+	if (v == NULL || n == NULL || a == NULL)
+		err(1, "calloc");
+	for (m = 0; m < nmanagers; m++) {
+		mp = &managers[m];
+		for (i = 0; i < mp->nsamples; i++) {
+			if (!mp->samples[i].pdu)
+				continue;
+			k = mp->samples[i].t / ((uint64_t)interval *
+			    1000000000);
+			if (k >= nint)
+				k = nint - 1;
+			if (n[k] == a[k]) {
+				a[k] = a[k] ? a[k] * 2 : 256;
+				v[k] = realloc(v[k], a[k] * sizeof(**v));
+				if (v[k] == NULL)
+					err(1, "realloc");
+			}
+			v[k][n[k]++] = mp->samples[i].us;
+		}
+	}
+
+	printf("%-6s %10s %9s %9s %9s\n", "time", "pdus/s", "p50", "p99",
+	    "max");
+	for (k = 0; k < nint; k++) {
+		if (n[k] == 0)
+			continue;
+		qsort(v[k], n[k], sizeof(**v), cmp_u32);
+		printf("%-6u %10.0f %9u %9u %9u\n", k * interval,
+		    (double)n[k] / interval, percentile(v[k], n[k], 0.5),
+		    percentile(v[k], n[k], 0.99), v[k][n[k] - 1]);
+		free(v[k]);
+	}
+	free(v);
+	free(n);
+	free(a);
+}
+
+static void
+report(double elapsed)
+{
+	uint64_t ops[LOAD_NOPS], pdus, timeouts, errors, total;
+	u_int m, op;
+
+	memset(ops, 0, sizeof(ops));
+	pdus = timeouts = errors = 0;
+	for (m = 0; m < nmanagers; m++) {
+		for (op = 0; op < LOAD_NOPS; op++)
+			ops[op] += managers[m].ops[op];
+		pdus += managers[m].pdus;
+		timeouts += managers[m].timeouts;
+		errors += managers[m].errors;
+	}
+	total = ops[LOAD_GET] + ops[LOAD_BULK] + ops[LOAD_WALK];
+
+	print_series();
+	printf("\nmanagers %u, target %.0f ops/s, achieved %.0f ops/s, "
+	    "%.0f pdus/s\n", nmanagers, rate, total / elapsed, pdus / elapsed);
+	printf("ops: get %ju, bulk %ju, walk %ju; timeouts %ju, errors %ju\n\n",
+	    (uintmax_t)ops[LOAD_GET], (uintmax_t)ops[LOAD_BULK],
+	    (uintmax_t)ops[LOAD_WALK], (uintmax_t)timeouts, (uintmax_t)errors);
+	printf("%-6s %-4s %10s %9s %9s %9s %9s\n", "mix", "of", "samples",
+	    "p50 us", "p99 us", "p999 us", "max us");
+	for (op = 0; op < LOAD_NOPS; op++) {
+		print_latency(load_names[op], op, 1);
+		print_latency(load_names[op], op, 0);
+	}
+	print_latency("all", LOAD_NOPS, 1);
+	print_latency("all", LOAD_NOPS, 0);
+}
+
+static void
+agent_stop(void)
+{
+
+	if (agent_pid > 0) {
+		kill(agent_pid, SIGTERM);
+		waitpid(agent_pid, NULL, 0);
+		agent_pid = -1;
+	}
+	if (config_path[0] != '\0')
+		unlink(config_path);
+	if (pid_path[0] != '\0')
+		unlink(pid_path);
+	if (config_path[0] != '\0')
+		rmdir(tmpdir);
+}
+
+/* Start bsnmpd on the loopback port with the module loaded. */
+static void
+agent_start(void)
+{
+	FILE *fp, *xp;
+	char line[1024];
+
+	if (mkdtemp(tmpdir) == NULL)
+		err(1, "mkdtemp");
+	snprintf(config_path, sizeof(config_path), "%s/snmpd.config", tmpdir);
+	snprintf(pid_path, sizeof(pid_path), "%s/snmpd.pid", tmpdir);
+	if ((fp = fopen(config_path, "w")) == NULL)
+		err(1, "%s", config_path);
+	fprintf(fp, "begemotSnmpdPortStatus.127.0.0.1.%u = 1\n", port);
+	fprintf(fp, "begemotSnmpdCommunityString.0.1 = \"%s\"\n", community);
+	fprintf(fp, "begemotSnmpdModulePath.\"ucd\" = \"%s\"\n", module);
+	if (extra_config != NULL) {
+		if ((xp = fopen(extra_config, "r")) == NULL)
+			err(1, "%s", extra_config);
+		while (fgets(line, sizeof(line), xp) != NULL)
+			fputs(line, fp);
+		fclose(xp);
+	}
+	fclose(fp);
+
+	agent_pid = fork();
+	if (agent_pid == -1)
+		err(1, "fork");
+	if (agent_pid == 0) {
+		execl(bsnmpd, "bsnmpd", "-d", "-c", config_path, "-p",
+		    pid_path, (char *)NULL);
+		err(1, "%s", bsnmpd);
+	}
+	atexit(agent_stop);
+}
+
+/* Wait until the agent answers a GET for the module scalars. */
+static void
+agent_wait(void)
+{
+	struct manager probe;
+	struct snmp_pdu req, resp;
+	u_int i;
+
+	memset(&probe, 0, sizeof(probe));
+	probe.s = manager_socket();
+	for (i = 0; i < 50; i++) {
+		if (agent_pid > 0 && waitpid(agent_pid, NULL, WNOHANG) != 0) {
+			agent_pid = -1;
+			errx(1, "%s has exited", bsnmpd);
+		}
+		pdu_init(&req, SNMP_PDU_GET);
+		pdu_add(&req, &oid_get[OID_GET_PROBE]);
+		if (pdu_dialog(&probe, &req, &resp) == -1) {
+			usleep(100000);
+			continue;
+		}
+		if (resp.error_status != SNMP_ERR_NOERROR ||
+		    resp.bindings[0].syntax != SNMP_SYNTAX_INTEGER)
+			errx(1, "the ucd module is not loaded");
+		snmp_pdu_free(&resp);
+		close(probe.s);
+		return;
+	}
+	errx(1, "the agent is not responding");
+}
+
+static void
+parse_mix(char *s)
+{
+	char *p, *v;
+	u_int op;
+
+	memset(mix, 0, sizeof(mix));
+	while ((p = strsep(&s, ",")) != NULL) {
+		if ((v = strchr(p, '=')) == NULL)
+			errx(1, "bad mix %s", p);
+		*v++ = '\0';
+		for (op = 0; op < LOAD_NOPS; op++)
+			if (strcmp(p, load_names[op]) == 0)
+				break;
+		if (op == LOAD_NOPS)
+			errx(1, "bad mix operation %s", p);
+		mix[op] = strtoul(v, NULL, 10);
+	}
+	if (mix[LOAD_GET] + mix[LOAD_BULK] + mix[LOAD_WALK] == 0)
+		errx(1, "empty mix");
+}
+
+static void
+parse_agent(const char *s)
+{
+	char host[256], *p;
+
+	strlcpy(host, s, sizeof(host));
+	if ((p = strrchr(host, ':')) != NULL) {
+		*p++ = '\0';
+		port = strtoul(p, NULL, 10);
+	}
+	if (inet_pton(AF_INET, host, &agent_addr.sin_addr) != 1)
+		errx(1, "bad agent address %s", host);
+}
+
+static void
+on_signal(int sig __unused)
+{
+
+	stop = 1;
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr,
+	    "usage: ucdload [-a host:port | [-b bsnmpd] [-M module] "
+	    "[-C config] [-p port]]\n"
+	    "\t[-c community] [-d seconds] [-i seconds] [-m managers] "
+	    "[-R maxrep]\n"
+	    "\t[-r ops/s] [-t timeout_ms] [-x get=N,bulk=N,walk=N]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct sigaction sa;
+	uint64_t seed;
+	u_int m;
+	int ch, error;
+
+	while ((ch = getopt(argc, argv, "a:b:C:c:d:i:M:m:p:R:r:t:x:")) != -1) {
+		switch (ch) {
+		case 'a':
+			agent = optarg;
+			break;
+		case 'b':
+			bsnmpd = optarg;
+			break;
+		case 'C':
+			extra_config = optarg;
+			break;
+		case 'c':
+			community = optarg;
+			break;
+		case 'd':
+			duration = strtoul(optarg, NULL, 10);
+			break;
+		case 'i':
+			interval = strtoul(optarg, NULL, 10);
+			break;
+		case 'M':
+			module = optarg;
+			break;
+		case 'm':
+			nmanagers = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			port = strtoul(optarg, NULL, 10);
+			break;
+		case 'R':
+			maxrep = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			rate = strtod(optarg, NULL);
+			break;
+		case 't':
+			timeout = strtoul(optarg, NULL, 10);
+			break;
+		case 'x':
+			parse_mix(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc != optind || duration == 0 || interval == 0 ||
+	    nmanagers == 0 || maxrep == 0 || rate <= 0 || timeout == 0)
+		usage();
+
+	agent_addr.sin_family = AF_INET;
+	agent_addr.sin_len = sizeof(agent_addr);
+	agent_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (agent != NULL)
+		parse_agent(agent);
+	agent_addr.sin_port = htons(port);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if (agent == NULL)
+		agent_start();
+	agent_wait();
+
+	managers = calloc(nmanagers, sizeof(*managers));
+	if (managers == NULL)
+		err(1, "calloc");
+	seed = now();
+	start_ns = now();
+	for (m = 0; m < nmanagers; m++) {
+		managers[m].s = manager_socket();
+		managers[m].rnd = seed + (uint64_t)m * 0x9e3779b97f4a7c15ULL;
+		if (managers[m].rnd == 0)
+			managers[m].rnd = 1;
+		error = pthread_create(&managers[m].thread, NULL,
+		    manager_main, &managers[m]);
+		if (error != 0)
+			errc(1, error, "pthread_create");
+	}
+	for (m = 0; m < nmanagers; m++)
+		pthread_join(managers[m].thread, NULL);
+
+	report((now() - start_ns) / 1e9);
+
+	for (m = 0; m < nmanagers; m++) {
+		close(managers[m].s);
+		free(managers[m].samples);
+	}
+	free(managers);
+	return (0);
+}
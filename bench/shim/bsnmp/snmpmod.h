@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+/*
+ * Stand-in for <bsnmp/snmpmod.h>: the part of the bsnmpd module API used
+ * by the module, for building the benchmark without bsnmpd.
+ */
+
+#ifndef BENCH_SNMPMOD_H
+#define BENCH_SNMPMOD_H
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ASN_MAXOIDLEN	128
+
+typedef uint32_t asn_subid_t;
+
+struct asn_oid {
+	u_int		len;
+	asn_subid_t	subs[ASN_MAXOIDLEN];
+};
+
+enum snmp_syntax {
+	SNMP_SYNTAX_NULL,
+	SNMP_SYNTAX_INTEGER,
+	SNMP_SYNTAX_OCTETSTRING,
+	SNMP_SYNTAX_OID,
+	SNMP_SYNTAX_IPADDRESS,
+	SNMP_SYNTAX_COUNTER,
+	SNMP_SYNTAX_GAUGE,
+	SNMP_SYNTAX_TIMETICKS,
+	SNMP_SYNTAX_COUNTER64,
+};
+
+struct snmp_value {
+	struct asn_oid		var;
+	enum snmp_syntax	syntax;
+	union {
+		int32_t		integer;
+		struct {
+			u_int	len;
+			u_char	*octets;
+		} octetstring;
+		struct asn_oid	oid;
+		u_char		ipaddress[4];
+		uint32_t	uint32;
+		uint64_t	counter64;
+	} v;
+};
+
+enum snmp_op {
+	SNMP_OP_GET = 1,
+	SNMP_OP_GETNEXT,
+	SNMP_OP_SET,
+	SNMP_OP_COMMIT,
+	SNMP_OP_ROLLBACK,
+};
+
+enum snmp_error {
+	SNMP_ERR_NOERROR = 0,
+	SNMP_ERR_TOOBIG,
+	SNMP_ERR_NOSUCHNAME,
+	SNMP_ERR_BADVALUE,
+	SNMP_ERR_READONLY,
+	SNMP_ERR_GENERR,
+	SNMP_ERR_NO_ACCESS,
+	SNMP_ERR_WRONG_TYPE,
+	SNMP_ERR_WRONG_LENGTH,
+	SNMP_ERR_WRONG_ENCODING,
+	SNMP_ERR_WRONG_VALUE,
+	SNMP_ERR_NO_CREATION,
+	SNMP_ERR_INCONS_VALUE,
+	SNMP_ERR_RES_UNAVAIL,
+	SNMP_ERR_COMMIT_FAILED,
+	SNMP_ERR_UNDO_FAILED,
+	SNMP_ERR_AUTH_ERR,
+	SNMP_ERR_NOT_WRITEABLE,
+	SNMP_ERR_INCONS_NAME,
+};
+
+struct snmp_scratch {
+	void		*ptr1;
+	void		*ptr2;
+	uint32_t	int1;
+	uint32_t	int2;
+};
+
+struct snmp_context {
+	u_int			var_index;
+	struct snmp_scratch	*scratch;
+	void			*dep;
+	void			*data;
+	u_int			flags;
+};
+
+struct lmodule;
+
+typedef int (*snmp_op_t)(struct snmp_context *, struct snmp_value *,
+    u_int, u_int, enum snmp_op);
+
+enum snmp_node_type {
+	SNMP_NODE_LEAF = 1,
+	SNMP_NODE_COLUMN,
+};
+
+#define SNMP_NODE_CANSET	0x0001
+
+struct snmp_node {
+	struct asn_oid		oid;
+	const char		*name;
+	enum snmp_node_type	type;
+	enum snmp_syntax	syntax;
+	snmp_op_t		op;
+	u_int			flags;
+	uint32_t		index;		/* Number of index values. */
+	void			*data;
+	void			*tree_data;
+};
+
+struct snmp_module {
+	const char		*comment;
+	int			(*init)(struct lmodule *, int, char *[]);
+	int			(*fini)(void);
+	void			(*idle)(void);
+	void			(*dump)(void);
+	void			(*config)(void);
+	void			(*start)(void);
+	void			*proxy;
+	const struct snmp_node	*tree;
+	u_int			tree_size;
+	void			(*loading)(const struct lmodule *, int);
+};
+
+uint64_t get_ticks(void);
+void *timer_start(u_int, void (*)(void *), void *, struct lmodule *);
+void *timer_start_repeat(u_int, u_int, void (*)(void *), void *,
+    struct lmodule *);
+void timer_stop(void *);
+void *fd_select(int, void (*)(int, void *), void *, struct lmodule *);
+void fd_deselect(void *);
+void fd_suspend(void *);
+int fd_resume(void *);
+int string_save(struct snmp_value *, struct snmp_context *, ssize_t,
+    u_char **);
+void string_commit(struct snmp_context *);
+void string_rollback(struct snmp_context *, u_char **);
+int string_get(struct snmp_value *, const u_char *, ssize_t);
+int string_get_max(struct snmp_value *, const u_char *, ssize_t, size_t);
+void string_free(struct snmp_context *);
+u_int or_register(const struct asn_oid *, const char *, struct lmodule *);
+void or_unregister(u_int);
+
+/* Insert into a TAILQ sorted by an integer index. */
+#define INSERT_OBJECT_INT_LINK_INDEX(PTR, LIST, LINK, INDEX) do {	\
+	__typeof (PTR) _lelem;						\
+									\
+	TAILQ_FOREACH(_lelem, (LIST), LINK)				\
+		if ((asn_subid_t)_lelem->INDEX >			\
+		    (asn_subid_t)(PTR)->INDEX)				\
+			break;						\
+	if (_lelem == NULL)						\
+		TAILQ_INSERT_TAIL((LIST), (PTR), LINK);			\
+	else								\
+		TAILQ_INSERT_BEFORE(_lelem, (PTR), LINK);		\
+} while (0)
+
+#define INSERT_OBJECT_INT(PTR, LIST)					\
+	INSERT_OBJECT_INT_LINK_INDEX(PTR, LIST, link, index)
+
+#define NEXT_OBJECT_INT_LINK_INDEX(LIST, OID, SUB, LINK, INDEX) ({	\
+	__typeof (TAILQ_FIRST((LIST))) _lelem;				\
+									\
+	if ((OID)->len - (SUB) == 0)					\
+		_lelem = TAILQ_FIRST(LIST);				\
+	else								\
+		TAILQ_FOREACH(_lelem, (LIST), LINK)			\
+			if ((OID)->subs[(SUB)] <			\
+			    (asn_subid_t)_lelem->INDEX)			\
+				break;					\
+	(_lelem);							\
+})
+
+#define NEXT_OBJECT_INT(LIST, OID, SUB)					\
+	NEXT_OBJECT_INT_LINK_INDEX(LIST, OID, SUB, link, index)
+
+#define FIND_OBJECT_INT_LINK_INDEX(LIST, OID, SUB, LINK, INDEX) ({	\
+	__typeof (TAILQ_FIRST((LIST))) _lelem;				\
+									\
+	if ((OID)->len - (SUB) != 1)					\
+		_lelem = NULL;						\
+	else								\
+		TAILQ_FOREACH(_lelem, (LIST), LINK)			\
+			if ((OID)->subs[(SUB)] ==			\
+			    (asn_subid_t)_lelem->INDEX)			\
+				break;					\
+	(_lelem);							\
+})
+
+#define FIND_OBJECT_INT(LIST, OID, SUB)					\
+	FIND_OBJECT_INT_LINK_INDEX(LIST, OID, SUB, link, index)
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+/*
+ * FreeBSD interfaces missing on other systems, included before every
+ * source file of the benchmark. Allocation and syslog calls of the module
+ * are redirected to the benchmark, which counts and silences them, and
+ * plugins are loaded from the benchmark itself (see datasrc.c).
+ */
+
+#ifndef BENCH_COMPAT_H
+#define BENCH_COMPAT_H
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#ifndef __unused
+#define __unused	__attribute__((__unused__))
+#endif
+
+#ifndef __DEVOLATILE
+#define __DEVOLATILE(type, var)	((type)(uintptr_t)(volatile void *)(var))
+#endif
+
+#ifndef __DECONST
+#define __DECONST(type, var)	((type)(uintptr_t)(const void *)(var))
+#endif
+
+#ifndef TAILQ_FOREACH_SAFE
+#define TAILQ_FOREACH_SAFE(var, head, field, tvar)			\
+	for ((var) = TAILQ_FIRST((head));				\
+	    (var) && ((tvar) = TAILQ_NEXT((var), field), 1);		\
+	    (var) = (tvar))
+#endif
+
+#ifndef LIST_FOREACH_SAFE
+#define LIST_FOREACH_SAFE(var, head, field, tvar)			\
+	for ((var) = LIST_FIRST((head));				\
+	    (var) && ((tvar) = LIST_NEXT((var), field), 1);		\
+	    (var) = (tvar))
+#endif
+
+#ifndef STAILQ_FOREACH_SAFE
+#define STAILQ_FOREACH_SAFE(var, head, field, tvar)			\
+	for ((var) = STAILQ_FIRST((head));				\
+	    (var) && ((tvar) = STAILQ_NEXT((var), field), 1);		\
+	    (var) = (tvar))
+#endif
+
+/* CPU states of kern.cp_time. */
+#ifndef CPUSTATES
+#define CPUSTATES	5
+#define CP_USER		0
+#define CP_NICE		1
+#define CP_SYS		2
+#define CP_INTR		3
+#define CP_IDLE		4
+#endif
+
+size_t bench_strlcpy(char *, const char *, size_t);
+size_t bench_strlcat(char *, const char *, size_t);
+int bench_flsll(long long);
+int getosreldate(void);
+pid_t bench_vfork(void);
+
+#define strlcpy		bench_strlcpy
+#define strlcat		bench_strlcat
+#define flsll		bench_flsll
+#define vfork		bench_vfork
+
+void *bench_malloc(size_t);
+void *bench_calloc(size_t, size_t);
+void *bench_realloc(void *, size_t);
+char *bench_strdup(const char *);
+void bench_syslog(int, const char *, ...);
+void *bench_dlopen(const char *, int);
+void *bench_dlsym(void *, const char *);
+int bench_dlclose(void *);
+
+#ifndef BENCH_NO_REDIRECT
+#define malloc		bench_malloc
+#define calloc		bench_calloc
+#define realloc		bench_realloc
+#define strdup		bench_strdup
+#define syslog		bench_syslog
+#define dlopen		bench_dlopen
+#define dlsym		bench_dlsym
+#define dlclose		bench_dlclose
+#endif
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef BENCH_DEVSTAT_H
+#define BENCH_DEVSTAT_H
+
+#include <sys/param.h>
+#include <sys/types.h>
+
+#include <stdint.h>
+
+#define DEVSTAT_NAME_LEN	16
+#define DEVSTAT_DEVICE_NAME	"devstat"
+#define DEVSTAT_ERRBUF_SIZE	2048
+
+typedef enum {
+	DEVSTAT_NO_DATA,
+	DEVSTAT_READ,
+	DEVSTAT_WRITE,
+	DEVSTAT_FREE
+} devstat_trans_flags;
+#define DEVSTAT_N_TRANS_FLAGS	4
+
+typedef enum {
+	DEVSTAT_TYPE_DIRECT	= 0x000,
+	DEVSTAT_TYPE_SEQUENTIAL	= 0x001,
+	DEVSTAT_TYPE_CDROM	= 0x005,
+	DEVSTAT_TYPE_MASK	= 0x00f,
+	DEVSTAT_TYPE_IF_SCSI	= 0x010,
+	DEVSTAT_TYPE_IF_IDE	= 0x020,
+	DEVSTAT_TYPE_IF_OTHER	= 0x030,
+	DEVSTAT_TYPE_IF_MASK	= 0x0f0,
+	DEVSTAT_TYPE_PASS	= 0x100
+} devstat_type_flags;
+
+typedef enum {
+	DEVSTAT_MATCH_NONE	= 0x00,
+	DEVSTAT_MATCH_TYPE	= 0x01,
+	DEVSTAT_MATCH_IF	= 0x02,
+	DEVSTAT_MATCH_PASS	= 0x04
+} devstat_match_flags;
+
+struct devstat_match {
+	devstat_match_flags	match_fields;
+	devstat_type_flags	device_type;
+	int			num_match_categories;
+};
+
+struct devstat {
+	u_int			sequence0;
+	int			allocated;
+	u_int			start_count;
+	u_int			end_count;
+	struct bintime		busy_from;
+	struct {
+		struct devstat	*stqe_next;
+	}			dev_links;
+	uint32_t		device_number;
+	char			device_name[DEVSTAT_NAME_LEN];
+	int			unit_number;
+	uint64_t		bytes[DEVSTAT_N_TRANS_FLAGS];
+	uint64_t		operations[DEVSTAT_N_TRANS_FLAGS];
+	struct bintime		duration[DEVSTAT_N_TRANS_FLAGS];
+	struct bintime		busy_time;
+	struct bintime		creation_time;
+	uint32_t		block_size;
+	uint64_t		tag_types[3];
+	int			flags;
+	devstat_type_flags	device_type;
+	int			priority;
+	const void		*id;
+	u_int			sequence1;
+};
+
+struct devinfo {
+	struct devstat		*devices;
+	uint8_t			*mem_ptr;
+	long			generation;
+	int			numdevs;
+};
+
+struct statinfo {
+	long			cp_time[CPUSTATES];
+	long			tk_nin;
+	long			tk_nout;
+	struct devinfo		*dinfo;
+	long double		snap_time;
+};
+
+extern char devstat_errbuf[];
+
+int devstat_checkversion(void *);
+int devstat_getnumdevs(void *);
+long devstat_getgeneration(void *);
+int devstat_getdevs(void *, struct statinfo *);
+int devstat_buildmatch(char *, struct devstat_match **, int *);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef BENCH_SYS_EVENT_H
+#define BENCH_SYS_EVENT_H
+
+#include <stdint.h>
+#include <time.h>
+
+struct kevent {
+	uintptr_t	ident;
+	short		filter;
+	unsigned short	flags;
+	unsigned int	fflags;
+	int64_t		data;
+	void		*udata;
+};
+
+#define EVFILT_READ	(-1)
+#define EVFILT_PROC	(-5)
+
+#define EV_ADD		0x0001
+#define EV_DELETE	0x0002
+#define EV_ONESHOT	0x0010
+#define EV_ERROR	0x4000
+#define EV_EOF		0x8000
+
+#define NOTE_EXIT	0x80000000
+#define NOTE_FORK	0x40000000
+#define NOTE_EXEC	0x20000000
+#define NOTE_TRACK	0x00000001
+#define NOTE_TRACKERR	0x00000002
+#define NOTE_CHILD	0x00000004
+
+#define EV_SET(kevp, a, b, c, d, e, f) do {				\
+	(kevp)->ident = (a);						\
+	(kevp)->filter = (b);						\
+	(kevp)->flags = (c);						\
+	(kevp)->fflags = (d);						\
+	(kevp)->data = (e);						\
+	(kevp)->udata = (f);						\
+} while (0)
+
+int kqueue(void);
+int kevent(int, const struct kevent *, int, struct kevent *, int,
+    const struct timespec *);
+
+#endif
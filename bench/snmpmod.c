@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+/*
+ * Stand-in for the bsnmpd module API. Time is virtual: get_ticks() returns
+ * bench_ticks, which is advanced by the benchmark, and timers are never
+ * fired by themselves, the benchmark calls the repeat timers explicitly.
+ * Selected descriptors are only handled when the benchmark polls them.
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bsnmp/snmpmod.h>
+
+#include "bench.h"
+
+uint64_t bench_ticks = 1;
+uint64_t bench_nalloc;
+uint64_t bench_nsyslog;
+int bench_verbose;
+
+struct bench_timer {
+	void		(*func)(void *);
+	void		*arg;
+	u_int		period;		/* 0 for one-shot timers. */
+	TAILQ_ENTRY(bench_timer) link;
+};
+
+static TAILQ_HEAD(, bench_timer) timers = TAILQ_HEAD_INITIALIZER(timers);
+
+struct bench_fd {
+	int		fd;
+	void		(*func)(int, void *);
+	void		*arg;
+	TAILQ_ENTRY(bench_fd) link;
+};
+
+static TAILQ_HEAD(, bench_fd) fds = TAILQ_HEAD_INITIALIZER(fds);
+
+uint64_t
+get_ticks(void)
+{
+
+	return (bench_ticks);
+}
+
+static void *
+timer_add(u_int period, void (*func)(void *), void *arg)
+{
+	struct bench_timer *tp;
+
+	tp = malloc(sizeof(*tp));
+	if (tp == NULL)
+		return (NULL);
+	tp->func = func;
+	tp->arg = arg;
+	tp->period = period;
+	TAILQ_INSERT_TAIL(&timers, tp, link);
+	return (tp);
+}
+
+void *
+timer_start(u_int ticks __unused, void (*func)(void *), void *arg,
+    struct lmodule *mod __unused)
+{
+
+	return (timer_add(0, func, arg));
+}
+
+void *
+timer_start_repeat(u_int ticks __unused, u_int period, void (*func)(void *),
+    void *arg, struct lmodule *mod __unused)
+{
+
+	return (timer_add(period, func, arg));
+}
+
+void
+timer_stop(void *id)
+{
+	struct bench_timer *tp;
+
+	tp = id;
+	if (tp == NULL)
+		return;
+	TAILQ_REMOVE(&timers, tp, link);
+	free(tp);
+}
+
+void
+bench_timers_foreach(void (*f)(void (*)(void *), void *, u_int, void *),
+    void *arg)
+{
+	struct bench_timer *tp;
+
+	TAILQ_FOREACH(tp, &timers, link)
+		if (tp->period != 0)
+			f(tp->func, tp->arg, tp->period, arg);
+}
+
+void *
+fd_select(int fd, void (*func)(int, void *), void *arg,
+    struct lmodule *mod __unused)
+{
+	struct bench_fd *fp;
+
+	fp = malloc(sizeof(*fp));
+	if (fp == NULL)
+		return (NULL);
+	fp->fd = fd;
+	fp->func = func;
+	fp->arg = arg;
+	TAILQ_INSERT_TAIL(&fds, fp, link);
+	return (fp);
+}
+
+void
+fd_deselect(void *id)
+{
+	struct bench_fd *fp;
+
+	fp = id;
+	if (fp == NULL)
+		return;
+	TAILQ_REMOVE(&fds, fp, link);
+	free(fp);
+}
+
+void
+bench_fd_poll(int timeout)
+{
+	struct pollfd *pfd;
+	struct bench_fd *fp;
+	u_int i, n;
+
+	n = 0;
+	TAILQ_FOREACH(fp, &fds, link)
+		n++;
+	if (n == 0)
+		return;
+	pfd = calloc(n, sizeof(*pfd));
+	if (pfd == NULL)
+		return;
+	i = 0;
+	TAILQ_FOREACH(fp, &fds, link) {
+		pfd[i].fd = fp->fd;
+		pfd[i].events = POLLIN;
+		i++;
+	}
+	if (poll(pfd, n, timeout) > 0) {
+		/* A handler may deselect descriptors, look them up again. */
+		for (i = 0; i < n; i++) {
+			if (pfd[i].revents == 0)
+				continue;
+			TAILQ_FOREACH(fp, &fds, link)
+				if (fp->fd == pfd[i].fd)
+					break;
+			if (fp != NULL)
+				fp->func(fp->fd, fp->arg);
+		}
+	}
+	free(pfd);
+}
+
+void
+fd_suspend(void *id __unused)
+{
+}
+
+int
+fd_resume(void *id __unused)
+{
+
+	return (0);
+}
+
+/*
+ * Octet strings returned to the agent are allocated the way libbsnmp does,
+ * so they are counted as allocations of the handler.
+ */
+int
+string_get(struct snmp_value *value, const u_char *ptr, ssize_t len)
+{
+
+	if (ptr == NULL) {
+		value->v.octetstring.len = 0;
+		value->v.octetstring.octets = NULL;
+		return (SNMP_ERR_NOERROR);
+	}
+	if (len == -1)
+		len = strlen((const char *)ptr);
+	value->v.octetstring.octets = bench_malloc(len == 0 ? 1 : len);
+	if (value->v.octetstring.octets == NULL)
+		return (SNMP_ERR_RES_UNAVAIL);
+	value->v.octetstring.len = len;
+	memcpy(value->v.octetstring.octets, ptr, len);
+	return (SNMP_ERR_NOERROR);
+}
+
+int
+string_get_max(struct snmp_value *value, const u_char *ptr, ssize_t len,
+    size_t maxlen)
+{
+
+	if (ptr != NULL && len == -1)
+		len = strlen((const char *)ptr);
+	if (ptr != NULL && (size_t)len > maxlen)
+		len = maxlen;
+	return (string_get(value, ptr, len));
+}
+
+int
+string_save(struct snmp_value *value, struct snmp_context *ctx,
+    ssize_t req_size, u_char **valp)
+{
+	u_char *p;
+
+	if (req_size != -1 && value->v.octetstring.len != (u_long)req_size)
+		return (SNMP_ERR_BADVALUE);
+	p = bench_malloc(value->v.octetstring.len + 1);
+	if (p == NULL)
+		return (SNMP_ERR_RES_UNAVAIL);
+	memcpy(p, value->v.octetstring.octets, value->v.octetstring.len);
+	p[value->v.octetstring.len] = '\0';
+	ctx->scratch->ptr1 = *valp;
+	*valp = p;
+	return (SNMP_ERR_NOERROR);
+}
+
+void
+string_commit(struct snmp_context *ctx)
+{
+
+	free(ctx->scratch->ptr1);
+	ctx->scratch->ptr1 = NULL;
+}
+
+void
+string_rollback(struct snmp_context *ctx, u_char **valp)
+{
+
+	free(*valp);
+	*valp = ctx->scratch->ptr1;
+	ctx->scratch->ptr1 = NULL;
+}
+
+void
+string_free(struct snmp_context *ctx)
+{
+
+	free(ctx->scratch->ptr1);
+	ctx->scratch->ptr1 = NULL;
+}
+
+u_int
+or_register(const struct asn_oid *oid __unused, const char *descr __unused,
+    struct lmodule *mod __unused)
+{
+
+	return (1);
+}
+
+void
+or_unregister(u_int idx __unused)
+{
+}
+
+/* Allocation functions the module is built with. */
+
+void *
+bench_malloc(size_t size)
+{
+
+	bench_nalloc++;
+	return (malloc(size));
+}
+
+void *
+bench_calloc(size_t n, size_t size)
+{
+
+	bench_nalloc++;
+	return (calloc(n, size));
+}
+
+void *
+bench_realloc(void *ptr, size_t size)
+{
+
+	bench_nalloc++;
+	return (realloc(ptr, size));
+}
+
+char *
+bench_strdup(const char *s)
+{
+
+	bench_nalloc++;
+	return (strdup(s));
+}
+
+void
+bench_syslog(int priority __unused, const char *fmt, ...)
+{
+	char buf[1024];
+	va_list ap;
+	int error;
+
+	error = errno;
+	bench_nsyslog++;
+	if (!bench_verbose)
+		return;
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "ucdbench: %s\n", buf);
+	errno = error;
+}
+
+/* FreeBSD libc functions. */
+
+size_t
+bench_strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t len;
+
+	len = strlen(src);
+	if (size > 0) {
+		if (len >= size)
+			size--;
+		else
+			size = len;
+		memcpy(dst, src, size);
+		dst[size] = '\0';
+	}
+	return (len);
+}
+
+size_t
+bench_strlcat(char *dst, const char *src, size_t size)
+{
+	size_t len;
+
+	len = strnlen(dst, size);
+	if (len == size)
+		return (len + strlen(src));
+	return (len + bench_strlcpy(dst + len, src, size - len));
+}
+
+int
+bench_flsll(long long mask)
+{
+
+	return (mask == 0 ? 0 : 64 - __builtin_clzll((unsigned long long)mask));
+}
+
+int
+getosreldate(void)
+{
+
+	return (1400097);
+}
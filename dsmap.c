@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#include <sys/param.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <machine/atomic.h>
+
+#include <devstat.h>
+#include <fcntl.h>
+#include <paths.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "snmp_ucd.h"
+
+/*
+ * devstat reader.
+ *
+ * The kernel keeps devstat entries in pages that can be mapped via
+ * /dev/devstat. We map them once and read the counters in place, extending
+ * the mapping only when the device list generation changes. If the device
+ * is not available (e.g. hidden in a jail) we fall back to
+ * devstat_getdevs(), reusing its buffer across calls.
+ */
+
+/* How many times to retry reading an entry that is being updated. */
+#define DSMAP_MAXRETRY	10
+
+static int version_ok;			/* Userland and kernel match. */
+static int fd = -1;			/* /dev/devstat descriptor. */
+static int pagesize;
+static u_char *mapp;			/* Mapped devstat pages. */
+static size_t npages;			/* Number of mapped pages. */
+static struct statinfo stats;		/* Fallback devstat_getdevs() data. */
+static struct devinfo dinfo;
+static struct devstat **devs;		/* Sorted list of devices. */
+static int ndevs;
+static long generation = -1;		/* Generation of devs. */
+
+static int
+devcmp(const void *a, const void *b)
+{
+	const struct devstat *d1, *d2;
+
+	d1 = *(const struct devstat * const *)a;
+	d2 = *(const struct devstat * const *)b;
+
+	/*
+	 * Sort the same way the kernel orders its device queue, which is
+	 * what devstat_getdevs() returns: by priority and then by the probe
+	 * order. Slots of removed devices are reused, so the probe order is
+	 * taken from the creation time, not from the slot position.
+	 */
+	if (d1->priority != d2->priority)
+		return (d1->priority > d2->priority ? -1 : 1);
+	if (d1->creation_time.sec != d2->creation_time.sec)
+		return (d1->creation_time.sec < d2->creation_time.sec ? -1 : 1);
+	if (d1->creation_time.frac != d2->creation_time.frac)
+		return (d1->creation_time.frac < d2->creation_time.frac ?
+		    -1 : 1);
+	return (d1 < d2 ? -1 : d1 > d2 ? 1 : 0);
+}
+
+static int
+devs_resize(int n)
+{
+	struct devstat **p;
+
+	p = realloc(devs, (n + 1) * sizeof(*p));
+	if (p == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (-1);
+	}
+	devs = p;
+	return (0);
+}
+
+/*
+ * Map one more page of devstat entries. Returns -1 if there are no more
+ * pages in the kernel.
+ */
+static int
+dsmap_grow(void)
+{
+	void *p;
+
+	if (mapp != NULL)
+		munmap(mapp, npages * pagesize);
+	p = mmap(NULL, (npages + 1) * pagesize, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		/* Restore the old mapping. */
+		mapp = NULL;
+		if (npages > 0) {
+			p = mmap(NULL, npages * pagesize, PROT_READ,
+			    MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED) {
+				syslog(LOG_ERR, "mmap failed: %s: %m",
+				    __func__);
+				npages = 0;
+				return (-1);
+			}
+			mapp = p;
+		}
+		return (-1);
+	}
+	mapp = p;
+	npages++;
+	return (0);
+}
+
+/*
+ * Rescan mapped pages for allocated entries.
+ */
+static int
+dsmap_rescan(long gen)
+{
+	struct devstat *dsp;
+	size_t perpage, i, n;
+	int numdevs;
+
+	numdevs = devstat_getnumdevs(NULL);
+	if (numdevs == -1) {
+		syslog(LOG_ERR, "devstat_getnumdevs failed: %s: %s", __func__,
+		    devstat_errbuf);
+		return (-1);
+	}
+	if (devs_resize(numdevs) == -1)
+		return (-1);
+
+	perpage = pagesize / sizeof(struct devstat);
+	for (;;) {
+		ndevs = 0;
+		for (i = 0; i < npages; i++) {
+			dsp = (struct devstat *)(mapp + i * pagesize);
+			for (n = 0; n < perpage; n++, dsp++) {
+				if (dsp->allocated && ndevs < numdevs)
+					devs[ndevs++] = dsp;
+			}
+		}
+		if (ndevs >= numdevs || dsmap_grow() == -1)
+			break;
+	}
+	qsort(devs, ndevs, sizeof(*devs), devcmp);
+	generation = gen;
+
+	return (0);
+}
+
+/*
+ * Get the list of devstat entries, refreshing it if the generation has
+ * changed. Returns the number of devices or -1 on error.
+ */
+int
+dsmap_getdevs(struct devstat ***devsp, long *generationp)
+{
+	long gen;
+	int i, res;
+
+	if (!version_ok)
+		return (-1);
+
+	if (fd == -1) {
+		res = devstat_getdevs(NULL, &stats);
+		if (res == -1) {
+			syslog(LOG_ERR, "devstat_getdevs failed: %s: %s",
+			    __func__, devstat_errbuf);
+			return (-1);
+		}
+		if (res == 1 || generation != dinfo.generation) {
+			if (devs_resize(dinfo.numdevs) == -1)
+				return (-1);
+			for (i = 0; i < dinfo.numdevs; i++)
+				devs[i] = &dinfo.devices[i];
+			ndevs = dinfo.numdevs;
+			generation = dinfo.generation;
+		}
+	} else {
+		gen = devstat_getgeneration(NULL);
+		if (gen == -1) {
+			syslog(LOG_ERR, "devstat_getgeneration failed: %s: %s",
+			    __func__, devstat_errbuf);
+			return (-1);
+		}
+		if (gen != generation && dsmap_rescan(gen) == -1)
+			return (-1);
+	}
+
+	*devsp = devs;
+	*generationp = generation;
+	return (ndevs);
+}
+
+/*
+ * Read the counters of the device. The kernel increments sequence1 before
+ * updating the entry and sequence0 after, so the copy is consistent if
+ * sequence0 read before it is equal to sequence1 read after.
+ */
+void
+dsmap_read(const struct devstat *dsp, struct dsmap_stat *st)
+{
+	u_int seq;
+	int i;
+
+	for (i = 0; i < DSMAP_MAXRETRY; i++) {
+		seq = atomic_load_acq_int(
+		    __DEVOLATILE(volatile u_int *, &dsp->sequence0));
+		memcpy(st->bytes, dsp->bytes, sizeof(st->bytes));
+		memcpy(st->operations, dsp->operations,
+		    sizeof(st->operations));
+		st->busy_time = dsp->busy_time;
+		atomic_thread_fence_acq();
+		if (seq == dsp->sequence1)
+			break;
+	}
+}
+
+void
+dsmap_init(void)
+{
+
+	pagesize = getpagesize();
+
+	if (devstat_checkversion(NULL) == -1) {
+		syslog(LOG_ERR,
+		    "userland and kernel devstat version mismatch: %s",
+		    __func__);
+		version_ok = 0;
+		return;
+	}
+	version_ok = 1;
+
+	memset(&stats, 0, sizeof(stats));
+	memset(&dinfo, 0, sizeof(dinfo));
+	stats.dinfo = &dinfo;
+
+	fd = open(_PATH_DEV DEVSTAT_DEVICE_NAME, O_RDONLY);
+	if (fd == -1) {
+		syslog(LOG_WARNING, "failed to open %s, falling back to "
+		    "devstat_getdevs: %s: %m", _PATH_DEV DEVSTAT_DEVICE_NAME,
+		    __func__);
+	}
+}
+
+void
+dsmap_fini(void)
+{
+
+	if (mapp != NULL)
+		munmap(mapp, npages * pagesize);
+	mapp = NULL;
+	npages = 0;
+	if (fd != -1)
+		close(fd);
+	fd = -1;
+	free(dinfo.mem_ptr);
+	dinfo.mem_ptr = NULL;
+	free(devs);
+	devs = NULL;
+	ndevs = 0;
+	generation = -1;
+}
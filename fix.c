@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "snmp_ucd.h"
+
+/*
+ * Remediation engine: runs extTable and prTable fix commands.
+ *
+ * While the entry condition holds the fix is retried with exponential
+ * backoff, starting from extUpdateInterval and up to FIX_BACKOFF_MAX.
+ * A command that is already running for another entry is not started
+ * again, and the total number of launches is limited by fixMaxPerMinute.
+ */
+
+#define FIX_BACKOFF_MAX		360000	/* 1 hour. */
+
+/* Delays of the entry that have been counted, in fix->_delayed. */
+#define FIX_DELAYED_BACKOFF	0x01
+#define FIX_DELAYED_THROTTLE	0x02
+
+struct fix_run {
+	TAILQ_ENTRY(fix_run)	link;
+	u_char			*command;
+	struct spawn		sp;
+	struct fix		*owner;		/* Entry that launched it. */
+};
+
+TAILQ_HEAD(fix_run_list, fix_run);
+
+static struct fix_run_list fix_runs = TAILQ_HEAD_INITIALIZER(fix_runs);
+static int fix_running;
+static uint32_t fix_launched;		/* Fix commands started. */
+static uint32_t fix_deduped;		/* Skipped as already running. */
+static uint32_t fix_throttled;		/* Fixes delayed by fixMaxPerMinute. */
+static uint32_t fix_backedoff;		/* Fixes delayed by the backoff. */
+static uint32_t fix_failed;		/* Returned nonzero status. */
+static double fix_tokens;		/* Launches available now. */
+static uint64_t fix_tokens_ticks;	/* Last fix_tokens update. */
+
+/*
+ * Token bucket refilled at fixMaxPerMinute rate.
+ */
+static int
+fix_take_token(void)
+{
+	uint64_t current;
+
+	if (fix_max_per_minute == 0)
+		return (1);
+
+	current = get_ticks();
+	fix_tokens += (double)(current - fix_tokens_ticks) *
+	    fix_max_per_minute / 6000;
+	fix_tokens_ticks = current;
+	if (fix_tokens > fix_max_per_minute)
+		fix_tokens = fix_max_per_minute;
+	if (fix_tokens < 1)
+		return (0);
+	fix_tokens -= 1;
+	return (1);
+}
+
+static void
+fix_run_free(struct fix_run *run)
+{
+
+	TAILQ_REMOVE(&fix_runs, run, link);
+	if (run->owner != NULL)
+		run->owner->_run = NULL;
+	free(run->command);
+	free(run);
+}
+
+static void
+fix_done(void *arg)
+{
+	struct fix_run *run;
+
+	run = (struct fix_run *)arg;
+	fix_running--;
+	if (run->sp.status != 0) {
+		fix_failed++;
+		syslog(LOG_WARNING, "command `%s' has retuned status %d",
+		    run->command, run->sp.status);
+	}
+	if (run->owner != NULL)
+		spawn_stats_add(&run->owner->stats, &run->sp.stats);
+	fix_run_free(run);
+}
+
+/*
+ * Schedule the next attempt.
+ */
+static void
+fix_backoff(struct fix *fp)
+{
+	uint64_t delay;
+	u_int i;
+
+	delay = ext_update_interval;
+	for (i = 0; i < fp->_attempts && delay < FIX_BACKOFF_MAX; i++)
+		delay *= 2;
+	if (delay > FIX_BACKOFF_MAX)
+		delay = FIX_BACKOFF_MAX;
+	fp->_attempts++;
+	fp->_next = get_ticks() + delay;
+	fp->_delayed = 0;
+}
+
+void
+fix_init(struct fix *fp)
+{
+
+	memset(fp, 0, sizeof(*fp));
+}
+
+/*
+ * The entry needs fixing: run the command unless it is delayed.
+ */
+void
+fix_request(struct fix *fp, const u_char *command)
+{
+	struct fix_run *run;
+
+	if (fp->_run != NULL)
+		return;	/* Still running. */
+
+	if (get_ticks() < fp->_next) {
+		if ((fp->_delayed & FIX_DELAYED_BACKOFF) == 0)
+			fix_backedoff++;
+		fp->_delayed |= FIX_DELAYED_BACKOFF;
+		return;
+	}
+
+	TAILQ_FOREACH(run, &fix_runs, link) {
+		if (strcmp((const char *)run->command,
+		    (const char *)command) == 0)
+			break;
+	}
+	if (run != NULL) {
+		/* Somebody is already fixing it. */
+		fix_deduped++;
+		fix_backoff(fp);
+		return;
+	}
+
+	if (!fix_take_token()) {
+		if ((fp->_delayed & FIX_DELAYED_THROTTLE) == 0)
+			fix_throttled++;
+		fp->_delayed |= FIX_DELAYED_THROTTLE;
+		return;
+	}
+
+	run = malloc(sizeof(*run));
+	if (run == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return;
+	}
+	run->command = (u_char *)strdup((const char *)command);
+	if (run->command == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		free(run);
+		return;
+	}
+	spawn_init(&run->sp, NULL, fix_done, run);
+	fix_backoff(fp);
+	fix_launched++;
+
+	if (spawn_start(&run->sp, command, ext_timeout) == -1) {
+		spawn_stats_add(&fp->stats, &run->sp.stats);
+		free(run->command);
+		free(run);
+		return;
+	}
+	run->owner = fp;
+	fp->_run = run;
+	TAILQ_INSERT_TAIL(&fix_runs, run, link);
+	fix_running++;
+}
+
+/*
+ * The entry does not need fixing any more: reset the backoff.
+ */
+void
+fix_reset(struct fix *fp)
+{
+
+	fp->_attempts = 0;
+	fp->_next = 0;
+	fp->_delayed = 0;
+}
+
+/*
+ * The entry is going away. Its running fix is left to complete.
+ */
+void
+fix_cancel(struct fix *fp)
+{
+
+	if (fp->_run != NULL)
+		fp->_run->owner = NULL;
+	fp->_run = NULL;
+}
+
+int
+op_fix(struct snmp_context * context __unused, struct snmp_value * value,
+	u_int sub, u_int iidx __unused, enum snmp_op op)
+{
+	asn_subid_t which;
+
+	which = value->var.subs[sub - 1];
+
+	switch (op) {
+	case SNMP_OP_GET:
+		break;
+	case SNMP_OP_GETNEXT:
+	case SNMP_OP_ROLLBACK:
+	case SNMP_OP_COMMIT:
+		return (SNMP_ERR_NOERROR);
+	case SNMP_OP_SET:
+		return (SNMP_ERR_NOT_WRITEABLE);
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+
+	switch (which) {
+	case LEAF_fixRunning:
+		value->v.integer = fix_running;
+		break;
+	case LEAF_fixLaunched:
+		value->v.uint32 = fix_launched;
+		break;
+	case LEAF_fixDeduped:
+		value->v.uint32 = fix_deduped;
+		break;
+	case LEAF_fixThrottled:
+		value->v.uint32 = fix_throttled;
+		break;
+	case LEAF_fixBackedOff:
+		value->v.uint32 = fix_backedoff;
+		break;
+	case LEAF_fixFailed:
+		value->v.uint32 = fix_failed;
+		break;
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+	return (SNMP_ERR_NOERROR);
+}
+
+/*
+ * Kill running fix commands.
+ */
+void
+fix_fini(void)
+{
+	struct fix_run *run;
+
+	while ((run = TAILQ_FIRST(&fix_runs)) != NULL) {
+		spawn_stop(&run->sp);
+		fix_run_free(run);
+	}
+	fix_running = 0;
+}
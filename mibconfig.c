@@ -34,6 +34,19 @@ u_int update_interval;
 u_int ext_check_interval;
 u_int ext_update_interval;
 u_int ext_timeout;
+u_char *diskio_match;
+u_char *diskio_include;
+u_char *diskio_exclude;
+u_int diskio_fast_devices;
+u_int ext_max_running;
+u_int ext_output_max_bytes;
+u_int ext_output_max_lines;
+u_int ext_output_budget;
+u_int fix_max_per_minute;
+#ifndef WITHOUT_PR
+u_int pr_scan_interval;
+#endif
+u_int hist_samples;
 int osreldate;
 
 /*
@@ -47,14 +60,26 @@ mibconfig_init(void)
 	ext_check_interval = 100;
 	ext_update_interval = 3000;
 	ext_timeout = 60;
+	ext_max_running = 0;
+	ext_output_max_bytes = 16384;
+	ext_output_max_lines = 256;
+	ext_output_budget = 1048576;
+	fix_max_per_minute = 10;
+#ifndef WITHOUT_PR
+	pr_scan_interval = 30000;
+#endif
+	hist_samples = HIST_SAMPLES;
 	osreldate = getosreldate();
 }
 
-int
-op_config(struct snmp_context * context __unused, struct snmp_value * value,
+static int
+do_config(struct snmp_context * context, struct snmp_value * value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	asn_subid_t which;
+#ifndef WITHOUT_DIO
+	int ret;
+#endif
 
 	which = value->var.subs[sub - 1];
 
@@ -73,6 +98,47 @@ op_config(struct snmp_context * context __unused, struct snmp_value * value,
 		case LEAF_extTimeout:
 			value->v.integer = ext_timeout;
 			break;
+#ifndef WITHOUT_DIO
+		case LEAF_diskIOMatch:
+			return (string_get(value, diskio_match, -1));
+		case LEAF_diskIOInclude:
+			return (string_get(value, diskio_include, -1));
+		case LEAF_diskIOExclude:
+			return (string_get(value, diskio_exclude, -1));
+		case LEAF_diskIOFastDevices:
+			value->v.integer = diskio_fast_devices;
+			break;
+#endif
+#ifndef WITHOUT_EXT
+		case LEAF_extMaxRunning:
+			value->v.integer = ext_max_running;
+			break;
+		case LEAF_extOutputMaxBytes:
+			value->v.integer = ext_output_max_bytes;
+			break;
+		case LEAF_extOutputMaxLines:
+			value->v.integer = ext_output_max_lines;
+			break;
+		case LEAF_extOutputBudget:
+			value->v.integer = ext_output_budget;
+			break;
+#endif
+#if !defined(WITHOUT_EXT) || !defined(WITHOUT_PR)
+		case LEAF_fixMaxPerMinute:
+			value->v.integer = fix_max_per_minute;
+			break;
+#endif
+#ifndef WITHOUT_PR
+		case LEAF_prScanInterval:
+			value->v.integer = pr_scan_interval;
+			break;
+#endif
+		case LEAF_opStatsEnable:
+			value->v.integer = opstat_enable;
+			break;
+		case LEAF_histSamples:
+			value->v.integer = hist_samples;
+			break;
 		default:
 			return (SNMP_ERR_RES_UNAVAIL);
 		}
@@ -101,6 +167,81 @@ op_config(struct snmp_context * context __unused, struct snmp_value * value,
 				return (SNMP_ERR_WRONG_VALUE);
 			ext_timeout = value->v.integer;
 			break;
+#ifndef WITHOUT_DIO
+		case LEAF_diskIOMatch:
+			ret = string_save(value, context, -1, &diskio_match);
+			if (ret == SNMP_ERR_NOERROR)
+				mibdio_reset_filter();
+			return (ret);
+		case LEAF_diskIOInclude:
+			ret = string_save(value, context, -1, &diskio_include);
+			if (ret == SNMP_ERR_NOERROR)
+				mibdio_reset_filter();
+			return (ret);
+		case LEAF_diskIOExclude:
+			ret = string_save(value, context, -1, &diskio_exclude);
+			if (ret == SNMP_ERR_NOERROR)
+				mibdio_reset_filter();
+			return (ret);
+		case LEAF_diskIOFastDevices:
+			if (value->v.integer < 0 ||
+			    value->v.integer > DISKIO_MAX_FAST)
+				return (SNMP_ERR_WRONG_VALUE);
+			diskio_fast_devices = value->v.integer;
+			break;
+#endif
+#ifndef WITHOUT_EXT
+		case LEAF_extMaxRunning:
+			if (value->v.integer < 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			ext_max_running = value->v.integer;
+			break;
+		case LEAF_extOutputMaxBytes:
+			if (value->v.integer < 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			ext_output_max_bytes = value->v.integer;
+			break;
+		case LEAF_extOutputMaxLines:
+			if (value->v.integer < 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			ext_output_max_lines = value->v.integer;
+			break;
+		case LEAF_extOutputBudget:
+			if (value->v.integer < 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			ext_output_budget = value->v.integer;
+			mibext_trim_output();
+			break;
+#endif
+#if !defined(WITHOUT_EXT) || !defined(WITHOUT_PR)
+		case LEAF_fixMaxPerMinute:
+			if (value->v.integer < 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			fix_max_per_minute = value->v.integer;
+			break;
+#endif
+#ifndef WITHOUT_PR
+		case LEAF_prScanInterval:
+			if (value->v.integer < 10)
+				return (SNMP_ERR_WRONG_VALUE);
+			pr_scan_interval = value->v.integer;
+			break;
+#endif
+		case LEAF_opStatsEnable:
+			if (value->v.integer != 0 && value->v.integer != 1)
+				return (SNMP_ERR_WRONG_VALUE);
+			/* Start counting from scratch when enabled. */
+			if (value->v.integer && !opstat_enable)
+				opstat_reset();
+			opstat_enable = value->v.integer;
+			break;
+		case LEAF_histSamples:
+			if (value->v.integer < 0 ||
+			    value->v.integer > HIST_MAX_SAMPLES)
+				return (SNMP_ERR_WRONG_VALUE);
+			hist_samples = value->v.integer;
+			mibhist_resize();
+			break;
 		default:
 			return (SNMP_ERR_RES_UNAVAIL);
 		}
@@ -113,3 +254,5 @@ op_config(struct snmp_context * context __unused, struct snmp_value * value,
 		return (SNMP_ERR_RES_UNAVAIL);
 	}
 };
+
+OPSTAT_HANDLER(config, OPSTAT_CONFIG)
@@ -32,6 +32,7 @@
 #include <sys/resource.h>
 
 #include <devstat.h>
+#include <fnmatch.h>
 #include <math.h>
 #include <paths.h>
 #include <stdlib.h>
@@ -50,34 +51,72 @@ struct mibdio {
 	TAILQ_ENTRY(mibdio)	link;
 	int32_t			index;
 	u_char			device[UCDMAXLEN];
-	int32_t			nRead;
-	int32_t			nWritten;
-	int32_t			reads;
-	int32_t			writes;
 	double			la1;
 	double			la5;
 	double			la15;
 	uint64_t		nReadX;
 	uint64_t		nWrittenX;
+	uint64_t		readsX;
+	uint64_t		writesX;
+	int32_t			busy;		/* Last busy percent * 100. */
+	int32_t			_busy_max;	/* Max busy in current period. */
+	int32_t			_busy_max_prev;	/* Max busy in previous period. */
+	uint64_t		_busy_max_ticks; /* Start of current period. */
 	struct bintime		_busy_time;
+	int			_pos;		/* Position in devstat list. */
+	int			_fast;		/* Sampled every second. */
+	uint64_t		_sample_ticks;
+	struct bintime		_sample_busy_time;
+	struct hist_metric	*_hist;		/* diskIOLA1 history. */
 };
 
 TAILQ_HEAD(mibdio_list, mibdio);
 
 static struct mibdio_list mibdio_list = TAILQ_HEAD_INITIALIZER(mibdio_list);
 
-static int version_ok;			/* Userland and kernel match. */
-static int ondevs;			/* Old number of devices. */
+/*
+ * Device filter compiled from diskIOMatch, diskIOInclude and diskIOExclude.
+ */
+struct dio_filter {
+	struct devstat_match	*matches;	/* Type/interface matches. */
+	int			num_matches;
+	char			**include;	/* Name patterns to include. */
+	char			**exclude;	/* Name patterns to exclude. */
+	int			valid;		/* Compiled from current config. */
+};
+
+static struct dio_filter dio_filter;
+
+static long ogeneration = -1;		/* Generation of the device list. */
+static int *dio_sel;			/* Positions of selected devices. */
+static int ndio_sel;			/* Number of selected devices. */
 static uint64_t last_dio_update;	/* Ticks of the last disk data update. */
+static int dio_loaded;			/* The device list was tried. */
 static double exp1, exp5, exp15;	/* DiskIOLA exponents. */
+static struct mibdio *dio_fast[DISKIO_MAX_FAST]; /* Busiest devices. */
+static int ndio_fast;
+
+/* Busy samples are taken every second for the busiest devices. */
+#define DIO_SAMPLE_INTERVAL	100
+
+/* diskIOBusyMax covers the samples of the last 1-2 minutes. */
+#define DIO_BUSY_MAX_INTERVAL	6000
 
 static void update_dio_data(void*);
+static void init_dio_data(void*);
+
+static struct table_index dio_index =
+    TABLE_INDEX_INITIALIZER(struct mibdio, index);
 
 static struct mibdio *
 find_dio (int32_t idx)
 {
 	struct mibdio *diop;
+	int error;
 
+	TABLE_INDEX_UPDATE(&dio_index, &mibdio_list, mibdio, error);
+	if (error == 0)
+		return (table_index_find(&dio_index, idx));
 	TAILQ_FOREACH(diop, &mibdio_list, link) {
 		if (diop->index == idx)
 			break;
@@ -96,56 +135,337 @@ mibdio_free (void)
 
 	while ((diop = TAILQ_FIRST(&mibdio_list)) != NULL) {
 		TAILQ_REMOVE (&mibdio_list, diop, link);
+		table_index_changed(&dio_index);
+		hist_metric_put(diop->_hist);
 		free (diop);
 	}
 }
 
-void
-update_dio_data(void *arg __unused)
+/*
+ * Split a string into whitespace separated words. The result is a NULL
+ * terminated array allocated as a single chunk together with the words.
+ */
+static char **
+split_words(const u_char *str)
+{
+	char **words, *buf, *word;
+	size_t len;
+	int n;
+
+	if (str == NULL || str[0] == '\0')
+		return (NULL);
+
+	len = strlen((const char *)str) + 1;
+	n = len / 2 + 1;	/* Max number of words. */
+	words = malloc((n + 1) * sizeof(*words) + len);
+	if (words == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (NULL);
+	}
+	buf = (char *)(words + n + 1);
+	memcpy(buf, str, len);
+
+	n = 0;
+	while ((word = strsep(&buf, " \t")) != NULL) {
+		if (*word != '\0')
+			words[n++] = word;
+	}
+	words[n] = NULL;
+
+	return (words);
+}
+
+static int
+match_words(char **words, const char *name)
+{
+	int i;
+
+	for (i = 0; words[i] != NULL; i++) {
+		if (fnmatch(words[i], name, 0) == 0)
+			return (1);
+	}
+	return (0);
+}
+
+static void
+dio_filter_free(void)
+{
+
+	free(dio_filter.matches);
+	free(dio_filter.include);
+	free(dio_filter.exclude);
+	memset(&dio_filter, 0, sizeof(dio_filter));
+}
+
+/*
+ * Compile the filter from the current configuration.
+ */
+static void
+dio_filter_compile(void)
+{
+	char **words;
+	int i;
+
+	dio_filter_free();
+
+	/*
+	 * Every word of diskIOMatch is a devstat match expression in
+	 * iostat(8) -t format (e.g. "da", "da,IDE", "pass"). A device is
+	 * selected if it matches any of them.
+	 */
+	words = split_words(diskio_match);
+	for (i = 0; words != NULL && words[i] != NULL; i++) {
+		if (devstat_buildmatch(words[i], &dio_filter.matches,
+		    &dio_filter.num_matches) != 0) {
+			syslog(LOG_ERR, "%s: invalid diskIOMatch `%s': %s",
+			    __func__, words[i], devstat_errbuf);
+		}
+	}
+	free(words);
+
+	dio_filter.include = split_words(diskio_include);
+	dio_filter.exclude = split_words(diskio_exclude);
+	dio_filter.valid = 1;
+}
+
+/*
+ * Check if the device passes the filter.
+ */
+static int
+dio_filter_match(const struct devstat *dev)
+{
+	const struct devstat_match *m;
+	char name[DEVSTAT_NAME_LEN + 12];
+	int i, type;
+
+	if (dio_filter.num_matches > 0) {
+		type = dev->device_type;
+		for (i = 0; i < dio_filter.num_matches; i++) {
+			m = &dio_filter.matches[i];
+			if (m->match_fields == DEVSTAT_MATCH_NONE)
+				continue; /* Failed to parse. */
+			if ((m->match_fields & DEVSTAT_MATCH_TYPE) &&
+			    (type & DEVSTAT_TYPE_MASK) !=
+			    (m->device_type & DEVSTAT_TYPE_MASK))
+				continue;
+			if ((m->match_fields & DEVSTAT_MATCH_IF) &&
+			    (type & DEVSTAT_TYPE_IF_MASK) !=
+			    (m->device_type & DEVSTAT_TYPE_IF_MASK))
+				continue;
+			if ((m->match_fields & DEVSTAT_MATCH_PASS) &&
+			    (type & DEVSTAT_TYPE_PASS) !=
+			    (m->device_type & DEVSTAT_TYPE_PASS))
+				continue;
+			break;
+		}
+		if (i == dio_filter.num_matches)
+			return (0);
+	}
+
+	if (dio_filter.include == NULL && dio_filter.exclude == NULL)
+		return (1);
+
+	snprintf(name, sizeof(name), "%s%d", dev->device_name,
+	    dev->unit_number);
+
+	if (dio_filter.include != NULL && !match_words(dio_filter.include, name))
+		return (0);
+	if (dio_filter.exclude != NULL && match_words(dio_filter.exclude, name))
+		return (0);
+
+	return (1);
+}
+
+/*
+ * Rebuild the list of selected devices and mibdio list. This is done only
+ * when the device list generation or the filter changes.
+ */
+static void
+dio_select(struct devstat **devs, int ndevs, long generation)
 {
-	struct statinfo stats;
-	struct devinfo dinfo;
 	struct mibdio *diop;
-	struct devstat dev;
-	double interval, busy_time, percent;
-	uint64_t now;
-	int i, res, ndevs;
+	char name[sizeof("diskIOLA1.") + UCDMAXLEN];
+	int *sel, i;
+
+	if (!dio_filter.valid)
+		dio_filter_compile();
+
+	mibdio_free();
+	ndio_sel = 0;
+	ndio_fast = 0;
+	ogeneration = -1;
 
-	if (!version_ok)
+	sel = realloc(dio_sel, (ndevs + 1) * sizeof(*sel));
+	if (sel == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
 		return;
+	}
+	dio_sel = sel;
+
+	for (i = 0; i < ndevs; i++) {
+		if (!dio_filter_match(devs[i]))
+			continue;
+		diop = malloc(sizeof(*diop));
+		if (diop == NULL) {
+			syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+			return;
+		}
+		memset(diop, 0, sizeof(*diop));
+		diop->index = ndio_sel + 1;
+		diop->_pos = i;
+		snprintf((char *)diop->device, sizeof(diop->device), "%s%d",
+		    devs[i]->device_name, devs[i]->unit_number);
+		snprintf(name, sizeof(name), "diskIOLA1.%s", diop->device);
+		diop->_hist = hist_metric_get(name);
+		INSERT_OBJECT_INT(diop, &mibdio_list);
+		table_index_changed(&dio_index);
+		dio_sel[ndio_sel++] = i;
+	}
+	ogeneration = generation;
+}
 
-	memset(&stats, 0, sizeof(stats));
-	memset(&dinfo, 0, sizeof(dinfo));
-	stats.dinfo = &dinfo;
+/*
+ * Force the filter to be recompiled on the next update.
+ */
+void
+mibdio_reset_filter(void)
+{
 
-	res = devstat_getdevs(NULL, &stats);
+	dio_filter.valid = 0;
+}
+
+static double
+bintime_sec(const struct bintime *bt)
+{
+
+	return (bt->sec + (double)bt->frac / 18446744073709551616.0);
+}
 
-	if (res == -1) {
-		syslog(LOG_ERR, "devstat_getdevs failed: %s: %m", __func__);
+/*
+ * Busy time between two devstat snapshots, in seconds.
+ */
+static double
+busy_delta(const struct bintime *now, const struct bintime *old)
+{
+	double busy_time;
+
+	busy_time = bintime_sec(now) - bintime_sec(old);
+	if (busy_time < 0) /* FP loss of precision near zero. */
+		busy_time = 0;
+	return (busy_time);
+}
+
+static void
+dio_set_busy(struct mibdio *diop, double percent, uint64_t now)
+{
+
+	if (percent > 100)
+		percent = 100;
+	diop->busy = (int32_t)(percent * 100 + 0.5);
+	if (now - diop->_busy_max_ticks >= DIO_BUSY_MAX_INTERVAL) {
+		diop->_busy_max_prev = diop->_busy_max;
+		diop->_busy_max = 0;
+		diop->_busy_max_ticks = now;
+	}
+	if (diop->busy > diop->_busy_max)
+		diop->_busy_max = diop->busy;
+}
+
+/*
+ * Choose diskio_fast_devices devices with the highest diskIOLA1 for
+ * sampling every second.
+ */
+static void
+dio_select_fast(void)
+{
+	struct mibdio *diop;
+	int i, n, max;
+
+	for (i = 0; i < ndio_fast; i++)
+		dio_fast[i]->_fast = 0;
+	ndio_fast = 0;
+
+	max = diskio_fast_devices;
+	if (max > DISKIO_MAX_FAST)
+		max = DISKIO_MAX_FAST;
+	if (max == 0)
 		return;
+
+	/* Keep dio_fast sorted by la1 in descending order. */
+	TAILQ_FOREACH(diop, &mibdio_list, link) {
+		if (diop->la1 <= 0)
+			continue;
+		if (ndio_fast == max && diop->la1 <= dio_fast[max - 1]->la1)
+			continue;
+		n = ndio_fast < max ? ndio_fast++ : max - 1;
+		for (i = n; i > 0 && dio_fast[i - 1]->la1 < diop->la1; i--)
+			dio_fast[i] = dio_fast[i - 1];
+		dio_fast[i] = diop;
 	}
 
-	ndevs = stats.dinfo->numdevs;
-
-	if (ndevs != ondevs) {
-		/*
-		 * Number of devices has changed. Realloc mibdio.
-		 */
-		mibdio_free();
-
-		for(i = 0; i < ndevs; i++) {
-			diop = malloc(sizeof(*diop));
-			if (diop == NULL) {
-				syslog(LOG_ERR, "failed to malloc: %s: %m",
-				    __func__);
-				return;
-			}
-			memset(diop, 0, sizeof(*diop));
-			diop->index = i + 1;
-			INSERT_OBJECT_INT(diop, &mibdio_list);
+	for (i = 0; i < ndio_fast; i++) {
+		if (!dio_fast[i]->_fast)
+			dio_fast[i]->_sample_ticks = 0;
+		dio_fast[i]->_fast = 1;
+	}
+}
+
+/*
+ * Sample busy time of the busiest devices.
+ */
+static void
+sample_dio_data(void *arg __unused)
+{
+	struct devstat **devs;
+	struct dsmap_stat dev;
+	struct mibdio *diop;
+	uint64_t now;
+	long generation;
+	double interval;
+	int i;
+
+	if (ndio_fast == 0)
+		return;
+
+	if (dsmap_getdevs(&devs, &generation) == -1 ||
+	    generation != ogeneration)
+		return;	/* Wait for update_dio_data() to reselect devices. */
+
+	now = get_ticks();
+	for (i = 0; i < ndio_fast; i++) {
+		diop = dio_fast[i];
+		dsmap_read(devs[diop->_pos], &dev);
+		if (diop->_sample_ticks > 0 && now > diop->_sample_ticks) {
+			interval = (double)(now - diop->_sample_ticks) / 100;
+			dio_set_busy(diop, busy_delta(&dev.busy_time,
+			    &diop->_sample_busy_time) * 100 / interval, now);
 		}
-		ondevs = ndevs;
+		diop->_sample_busy_time = dev.busy_time;
+		diop->_sample_ticks = now;
 	}
+}
+
+void
+update_dio_data(void *arg __unused)
+{
+	struct devstat **devs;
+	struct dsmap_stat dev;
+	struct mibdio *diop;
+	double interval, percent;
+	uint64_t now;
+	long generation;
+	int i, ndevs;
+
+	dio_loaded = 1;
+	ndevs = dsmap_getdevs(&devs, &generation);
+	if (ndevs == -1)
+		return;
+
+	/*
+	 * Device list or filter has changed. Reselect devices.
+	 */
+	if (!dio_filter.valid || generation != ogeneration)
+		dio_select(devs, ndevs, generation);
 
 	now = get_ticks();
 	interval = (double)(now - last_dio_update) / 100;
@@ -158,53 +478,64 @@ update_dio_data(void *arg __unused)
 	/*
 	 * Fill mibdio list with devstat data.
 	 */
-	for(i = 0; i < ndevs; i++) {
-		dev = stats.dinfo->devices[i];
-		diop = find_dio(i+1);
-		snprintf((char *) diop->device, sizeof(diop->device), "%s%d",
-			 dev.device_name, dev.unit_number);
-		diop->nRead = (int32_t)dev.bytes[DEVSTAT_READ];
-		diop->nWritten = (int32_t)dev.bytes[DEVSTAT_WRITE];
-		diop->reads = (int32_t)dev.operations[DEVSTAT_READ];
-		diop->writes = (int32_t)dev.operations[DEVSTAT_WRITE];
+	diop = TAILQ_FIRST(&mibdio_list);
+	for(i = 0; i < ndio_sel && diop != NULL; i++) {
+		dsmap_read(devs[dio_sel[i]], &dev);
 		diop->nReadX = dev.bytes[DEVSTAT_READ];
 		diop->nWrittenX = dev.bytes[DEVSTAT_WRITE];
-		if (diop->_busy_time.sec > 0) {
-			busy_time = dev.busy_time.sec - diop->_busy_time.sec +
-			    (double)(dev.busy_time.frac - diop->_busy_time.frac)
-			    / (double)0xffffffffffffffffull;
-			if (busy_time < 0) /* FP loss of precision near zero. */
-				busy_time = 0;
-			percent = busy_time * 100 / interval;
+		diop->readsX = dev.operations[DEVSTAT_READ];
+		diop->writesX = dev.operations[DEVSTAT_WRITE];
+		if (diop->_busy_time.sec > 0 && interval > 0) {
+			percent = busy_delta(&dev.busy_time,
+			    &diop->_busy_time) * 100 / interval;
 			diop->la1 = diop->la1 * exp1 + percent * (1. - exp1);
 			diop->la5 = diop->la5 * exp5 + percent * (1. - exp5);
 			diop->la15 = diop->la15 * exp15 + percent * (1. - exp15);
+			hist_add(diop->_hist, (int32_t)(diop->la1 + 0.5));
+			/* Fast sampled devices have more recent data. */
+			if (!diop->_fast)
+				dio_set_busy(diop, percent, now);
 		}
 		diop->_busy_time = dev.busy_time;
+		diop = TAILQ_NEXT(diop, link);
 	}
 
-	/*
-	 * Free memory allocated by devstat_getdevs().
-	 */
-	free(stats.dinfo->mem_ptr);
-	stats.dinfo->mem_ptr = NULL;
+	dio_select_fast();
 
 	return;
 }
 
-int
-op_diskIOTable(struct snmp_context *context __unused, struct snmp_value *value,
+/*
+ * Read the device list, if neither the deferred init nor a request has
+ * done it yet.
+ */
+static void
+init_dio_data(void *arg __unused)
+{
+
+	if (!dio_loaded)
+		update_dio_data(NULL);
+}
+
+static int
+do_diskIOTable(struct snmp_context *context __unused, struct snmp_value *value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	struct mibdio *diop;
 	asn_subid_t which;
-	int ret;
+	int error, ret;
 
 	which = value->var.subs[sub - 1];
 
+	init_dio_data(NULL);
+
 	switch (op) {
 	case SNMP_OP_GETNEXT:
-		diop = NEXT_OBJECT_INT(&mibdio_list, &value->var, sub);
+		TABLE_INDEX_UPDATE(&dio_index, &mibdio_list, mibdio, error);
+		if (error == 0)
+			diop = table_index_next(&dio_index, &value->var, sub);
+		else
+			diop = NEXT_OBJECT_INT(&mibdio_list, &value->var, sub);
 		if (diop == NULL)
 			return (SNMP_ERR_NOSUCHNAME);
 		value->var.len = sub + 1;
@@ -242,31 +573,31 @@ op_diskIOTable(struct snmp_context *context __unused, struct snmp_value *value,
 		break;
 
 	case LEAF_diskIONRead:
-		value->v.integer = diop->nRead;
+		value->v.uint32 = (uint32_t)diop->nReadX;
 		break;
 
 	case LEAF_diskIONWritten:
-		value->v.uint32 = diop->nWritten;
+		value->v.uint32 = (uint32_t)diop->nWrittenX;
 		break;
 
 	case LEAF_diskIOReads:
-		value->v.uint32 = diop->reads;
+		value->v.uint32 = (uint32_t)diop->readsX;
 		break;
 
 	case LEAF_diskIOWrites:
-		value->v.uint32 = diop->writes;
+		value->v.uint32 = (uint32_t)diop->writesX;
 		break;
 
 	case LEAF_diskIOLA1:
-		value->v.uint32 = diop->la1;
+		value->v.integer = (int32_t)(diop->la1 + 0.5);
 		break;
 
 	case LEAF_diskIOLA5:
-		value->v.uint32 = diop->la5;
+		value->v.integer = (int32_t)(diop->la5 + 0.5);
 		break;
 
 	case LEAF_diskIOLA15:
-		value->v.uint32 = diop->la15;
+		value->v.integer = (int32_t)(diop->la15 + 0.5);
 		break;
 
 	case LEAF_diskIONReadX:
@@ -277,6 +608,35 @@ op_diskIOTable(struct snmp_context *context __unused, struct snmp_value *value,
 		value->v.counter64 = diop->nWrittenX;
 		break;
 
+	case LEAF_diskIOReadsX:
+		value->v.counter64 = diop->readsX;
+		break;
+
+	case LEAF_diskIOWritesX:
+		value->v.counter64 = diop->writesX;
+		break;
+
+	case LEAF_diskIOLA1Int:
+		value->v.integer = (int32_t)(diop->la1 * 100 + 0.5);
+		break;
+
+	case LEAF_diskIOLA5Int:
+		value->v.integer = (int32_t)(diop->la5 * 100 + 0.5);
+		break;
+
+	case LEAF_diskIOLA15Int:
+		value->v.integer = (int32_t)(diop->la15 * 100 + 0.5);
+		break;
+
+	case LEAF_diskIOBusy:
+		value->v.integer = diop->busy;
+		break;
+
+	case LEAF_diskIOBusyMax:
+		value->v.integer = diop->_busy_max > diop->_busy_max_prev ?
+		    diop->_busy_max : diop->_busy_max_prev;
+		break;
+
 	default:
 		ret = SNMP_ERR_RES_UNAVAIL;
 		break;
@@ -285,26 +645,27 @@ op_diskIOTable(struct snmp_context *context __unused, struct snmp_value *value,
 	return (ret);
 };
 
+OPSTAT_HANDLER(diskIOTable, OPSTAT_DISKIOTABLE)
+
 void
 mibdio_fini(void)
 {
 
 	mibdio_free();
+	table_index_free(&dio_index);
+	ndio_fast = 0;
+	dio_filter_free();
+	free(dio_sel);
+	dio_sel = NULL;
 }
 
 void
 mibdio_init(void)
 {
-	if ( devstat_checkversion(NULL) == -1) {
-		syslog(LOG_ERR,
-		    "userland and kernel devstat version mismatch: %s",
-		    __func__);
-		version_ok = 0;
-	} else {
-		version_ok = 1;
-	}
 
-	update_dio_data(NULL);
+	dio_loaded = 0;
 
+	register_deferred_init(init_dio_data);
 	register_update_interval_timer(update_dio_data);
+	register_sample_interval_timer(sample_dio_data);
 }
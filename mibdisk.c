@@ -32,7 +32,6 @@
 #include <sys/resource.h>
 #include <sys/queue.h>
 
-#include <devstat.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -64,15 +63,24 @@ TAILQ_HEAD(mibdisk_list, mibdisk);
 
 static struct mibdisk_list mibdisk_list = TAILQ_HEAD_INITIALIZER(mibdisk_list);
 
-static int version_ok;			/* Userland and kernel match. */
+/* Room left for the numbers in dskErrorMsg. */
+#define DSK_MSG_PATHLEN		((int)UCDMAXLEN - 64)
+
 static int ondevs;			/* Old number of devices. */
 static uint64_t last_disk_update;	/* Ticks of the last disk data update. */
 
+static struct table_index disk_index =
+    TABLE_INDEX_INITIALIZER(struct mibdisk, index);
+
 static struct mibdisk *
 find_disk(int32_t idx)
 {
 	struct mibdisk *dp;
+	int error;
 
+	TABLE_INDEX_UPDATE(&disk_index, &mibdisk_list, mibdisk, error);
+	if (error == 0)
+		return (table_index_find(&disk_index, idx));
 	TAILQ_FOREACH(dp, &mibdisk_list, link)
 		if (dp->index == idx)
 			return (dp);
@@ -92,6 +100,7 @@ mibdisk_free(int32_t idx)
 	while (dp != NULL) {
 		next = TAILQ_NEXT(dp, link);
 		TAILQ_REMOVE(&mibdisk_list, dp, link);
+		table_index_changed(&disk_index);
 		free(dp);
 		dp = next;
 	}
@@ -101,15 +110,10 @@ static int
 update_disk_data(void)
 {
 	struct statfs *mntbuf;
-	struct statinfo stats;
-	struct devinfo dinfo;
 	struct mibdisk *dp;
 	size_t mntsize;
 	int64_t used, availblks;
-	int i, res, ndevs;
-
-	if (!version_ok)
-		return (-1);
+	int i, ndevs;
 
 	if ((get_ticks() - last_disk_update) < update_interval)
 		return (0);
@@ -118,17 +122,6 @@ update_disk_data(void)
 
 	mntsize = getmntinfo(&mntbuf, MNT_NOWAIT);
 
-	memset(&stats, 0, sizeof(stats));
-	memset(&dinfo, 0, sizeof(dinfo));
-	stats.dinfo = &dinfo;
-
-	res = devstat_getdevs(NULL, &stats);
-
-	if (res == -1) {
-		syslog(LOG_ERR, "devstat_getdevs failed: %s: %m", __func__);
-		return (-1);
-	}
-
 	ndevs = mntsize;
 
 	/*
@@ -150,20 +143,21 @@ update_disk_data(void)
 			dp->minimum = -1;
 			dp->minPercent = -1;
 			INSERT_OBJECT_INT(dp, &mibdisk_list);
+			table_index_changed(&disk_index);
 		}
 	}
 	ondevs = ndevs;
 
 	/*
-	 * Fill mibdisk list with devstat data.
+	 * Fill mibdisk list with statfs data.
 	 */
 	for(i = 0; i < ndevs; i++) {
 
 		dp = find_disk(i+1);
-		strncpy((char*)dp->path, mntbuf[i].f_mntonname,
-		    sizeof(dp->path) - 1);
-		strncpy((char*)dp->device, mntbuf[i].f_mntfromname,
-		    sizeof(dp->device) - 1);
+		strlcpy((char*)dp->path, mntbuf[i].f_mntonname,
+		    sizeof(dp->path));
+		strlcpy((char*)dp->device, mntbuf[i].f_mntfromname,
+		    sizeof(dp->device));
 		dp->total = mntbuf[i].f_blocks * mntbuf[i].f_bsize / 1024;
 		dp->avail = mntbuf[i].f_bavail * mntbuf[i].f_bsize / 1024;
 		used = mntbuf[i].f_blocks - mntbuf[i].f_bfree;
@@ -179,22 +173,16 @@ update_disk_data(void)
 		    100 - dp->percent <= dp->minPercent) ? 1 : 0;
 	}
 
-	/*
-	 * Free memory allocated by devstat_getdevs().
-	 */
-	free(stats.dinfo->mem_ptr);
-	stats.dinfo->mem_ptr = NULL;
-
 	return (0);
 }
 
-int
-op_dskTable(struct snmp_context *context __unused, struct snmp_value *value,
+static int
+do_dskTable(struct snmp_context *context __unused, struct snmp_value *value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	struct mibdisk *dp;
 	asn_subid_t which;
-	int ret;
+	int error, ret;
 	u_char buf[UCDMAXLEN];
 
 	if (update_disk_data() == -1)
@@ -204,10 +192,13 @@ op_dskTable(struct snmp_context *context __unused, struct snmp_value *value,
 
 	switch (op) {
 	case SNMP_OP_GETNEXT:
-		if ((dp = NEXT_OBJECT_INT(&mibdisk_list, &value->var,
-		    sub)) == NULL) {
+		TABLE_INDEX_UPDATE(&disk_index, &mibdisk_list, mibdisk, error);
+		if (error == 0)
+			dp = table_index_next(&disk_index, &value->var, sub);
+		else
+			dp = NEXT_OBJECT_INT(&mibdisk_list, &value->var, sub);
+		if (dp == NULL)
 			return (SNMP_ERR_NOSUCHNAME);
-		}
 		value->var.len = sub + 1;
 		value->var.subs[sub] = dp->index;
 		break;
@@ -321,16 +312,22 @@ op_dskTable(struct snmp_context *context __unused, struct snmp_value *value,
 		value->v.integer = dp->errorFlag;
 		break;
 
-	case LEAF_prErrMessage:
+	case LEAF_dskErrorMsg:
+		/*
+		 * The message has to fit in a DisplayString, so cut a long
+		 * path rather than the numbers after it.
+		 */
 		if (dp->errorFlag) {
 			if (dp->minimum >= 0) {
 				snprintf((char*)buf, sizeof(buf),
-				    "%s: less than %d free (= %ju)", dp->path,
+				    "%.*s: less than %d free (= %ju)",
+				    DSK_MSG_PATHLEN, dp->path,
 				    dp->minimum, (uintmax_t)dp->avail);
 			} else {
 				snprintf((char*)buf, sizeof(buf),
-				    "%s: less than %d%% free (= %d%%)",
-				    dp->path, dp->minPercent, dp->percent);
+				    "%.*s: less than %d%% free (= %d%%)",
+				    DSK_MSG_PATHLEN, dp->path,
+				    dp->minPercent, dp->percent);
 			}
 		} else {
 			buf[0] = '\0';
@@ -346,23 +343,18 @@ op_dskTable(struct snmp_context *context __unused, struct snmp_value *value,
 	return (ret);
 }
 
+OPSTAT_HANDLER(dskTable, OPSTAT_DSKTABLE)
+
 void
 mibdisk_fini(void)
 {
 
 	mibdisk_free(0);
+	table_index_free(&disk_index);
 }
 
 void
 mibdisk_init(void)
 {
 
-	if ( devstat_checkversion(NULL) == -1) {
-		syslog(LOG_ERR,
-		    "userland and kernel devstat version mismatch: %s",
-		    __func__);
-		version_ok = 0;
-	} else {
-		version_ok = 1;
-	}
 }
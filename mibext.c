@@ -29,14 +29,10 @@
 
 #include <sys/types.h>
 #include <sys/queue.h>
-#include <sys/select.h>
-#include <sys/time.h>
-#include <sys/wait.h>
+#include <sys/socket.h>
 
 #include <errno.h>
-#include <fcntl.h>
-#include <paths.h>
-#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,6 +41,238 @@
 
 #include "snmp_ucd.h"
 
+/*
+ * Command output buffers.
+ *
+ * The output is stored in fixed size chunks taken from an arena shared by
+ * all commands. The arena never holds more than ext_output_budget bytes;
+ * when it is exhausted the output is truncated. Chunks released by a
+ * command are kept on a free list for reuse.
+ */
+
+#define EXT_CHUNK_SIZE	1024
+
+struct ext_chunk {
+	struct ext_chunk	*next;		/* Free list link. */
+	u_char			data[EXT_CHUNK_SIZE];
+};
+
+struct ext_line {
+	uint32_t		off;
+	uint32_t		len;
+};
+
+struct ext_buf {
+	struct ext_chunk	**chunks;
+	u_int			nchunks;
+	u_int			achunks;	/* Allocated chunks slots. */
+	size_t			len;
+	struct ext_line		*lines;
+	u_int			nlines;
+	u_int			alines;		/* Allocated lines slots. */
+	size_t			linestart;	/* Start of the current line. */
+	int			truncated;
+};
+
+static struct ext_chunk *ext_free_chunks;
+static size_t ext_chunks_total;		/* Chunks allocated by the arena. */
+static size_t ext_chunks_used;		/* Chunks held by buffers. */
+
+static struct ext_chunk *
+ext_chunk_get(void)
+{
+	struct ext_chunk *c;
+
+	if (ext_chunks_used >= ext_output_budget / EXT_CHUNK_SIZE)
+		return (NULL);
+
+	if ((c = ext_free_chunks) != NULL) {
+		ext_free_chunks = c->next;
+	} else {
+		c = malloc(sizeof(*c));
+		if (c == NULL) {
+			syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+			return (NULL);
+		}
+		ext_chunks_total++;
+	}
+	ext_chunks_used++;
+	return (c);
+}
+
+static void
+ext_chunk_put(struct ext_chunk *c)
+{
+
+	ext_chunks_used--;
+	if (ext_chunks_total > ext_output_budget / EXT_CHUNK_SIZE) {
+		/* The budget has been lowered. */
+		free(c);
+		ext_chunks_total--;
+		return;
+	}
+	c->next = ext_free_chunks;
+	ext_free_chunks = c;
+}
+
+/*
+ * Release free chunks above the budget.
+ */
+void
+mibext_trim_output(void)
+{
+	struct ext_chunk *c;
+
+	while (ext_chunks_total > ext_output_budget / EXT_CHUNK_SIZE &&
+	    (c = ext_free_chunks) != NULL) {
+		ext_free_chunks = c->next;
+		free(c);
+		ext_chunks_total--;
+	}
+}
+
+static void
+ext_buf_free(struct ext_buf *bp)
+{
+	u_int i;
+
+	for (i = 0; i < bp->nchunks; i++)
+		ext_chunk_put(bp->chunks[i]);
+	free(bp->chunks);
+	free(bp->lines);
+	memset(bp, 0, sizeof(*bp));
+}
+
+/*
+ * Store up to n bytes. Returns the number of bytes stored.
+ */
+static size_t
+ext_buf_write(struct ext_buf *bp, const char *data, size_t n)
+{
+	struct ext_chunk **p;
+	size_t done, off, len;
+
+	for (done = 0; done < n; done += len) {
+		if (bp->len >= ext_output_max_bytes)
+			break;
+		off = bp->len % EXT_CHUNK_SIZE;
+		if (bp->len / EXT_CHUNK_SIZE == bp->nchunks) {
+			if (bp->nchunks == bp->achunks) {
+				p = realloc(bp->chunks, (bp->achunks + 16) *
+				    sizeof(*p));
+				if (p == NULL) {
+					syslog(LOG_ERR,
+					    "failed to malloc: %s: %m",
+					    __func__);
+					break;
+				}
+				bp->chunks = p;
+				bp->achunks += 16;
+			}
+			if ((bp->chunks[bp->nchunks] = ext_chunk_get()) == NULL)
+				break;
+			bp->nchunks++;
+		}
+		len = n - done;
+		if (len > EXT_CHUNK_SIZE - off)
+			len = EXT_CHUNK_SIZE - off;
+		if (len > ext_output_max_bytes - bp->len)
+			len = ext_output_max_bytes - bp->len;
+		memcpy(bp->chunks[bp->nchunks - 1]->data + off, data + done,
+		    len);
+		bp->len += len;
+	}
+	return (done);
+}
+
+/*
+ * Finish the current line.
+ */
+static int
+ext_buf_eol(struct ext_buf *bp)
+{
+	struct ext_line *p;
+
+	if (bp->nlines == bp->alines) {
+		p = realloc(bp->lines, (bp->alines + 16) * sizeof(*p));
+		if (p == NULL) {
+			syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+			return (-1);
+		}
+		bp->lines = p;
+		bp->alines += 16;
+	}
+	bp->lines[bp->nlines].off = bp->linestart;
+	bp->lines[bp->nlines].len = bp->len - bp->linestart;
+	bp->nlines++;
+	bp->linestart = bp->len;
+	return (0);
+}
+
+/*
+ * Append the command output, splitting it into lines. Once a limit is
+ * reached the rest of the output is discarded.
+ */
+static void
+ext_buf_append(struct ext_buf *bp, const char *data, size_t n)
+{
+	const char *eol;
+	size_t len;
+
+	while (n > 0 && !bp->truncated) {
+		if (bp->nlines >= ext_output_max_lines) {
+			bp->truncated = 1;
+			break;
+		}
+		eol = memchr(data, '\n', n);
+		len = (eol != NULL) ? (size_t)(eol - data) : n;
+		if (ext_buf_write(bp, data, len) < len) {
+			bp->truncated = 1;
+			break;
+		}
+		if (eol == NULL)
+			break;
+		if (ext_buf_eol(bp) == -1) {
+			bp->truncated = 1;
+			break;
+		}
+		data += len + 1;
+		n -= len + 1;
+	}
+}
+
+/*
+ * Finish the output: the last line may have no newline.
+ */
+static void
+ext_buf_finish(struct ext_buf *bp)
+{
+
+	if (bp->len > bp->linestart && bp->nlines < ext_output_max_lines)
+		ext_buf_eol(bp);
+}
+
+/*
+ * Copy up to size bytes of the line to dst. Returns the number of bytes
+ * copied.
+ */
+static size_t
+ext_buf_line(const struct ext_buf *bp, u_int line, u_char *dst, size_t size)
+{
+	size_t off, end, len;
+
+	off = bp->lines[line].off;
+	end = off + (bp->lines[line].len < size ? bp->lines[line].len : size);
+	for (; off < end; off += len, dst += len) {
+		len = EXT_CHUNK_SIZE - off % EXT_CHUNK_SIZE;
+		if (len > end - off)
+			len = end - off;
+		memcpy(dst, bp->chunks[off / EXT_CHUNK_SIZE]->data +
+		    off % EXT_CHUNK_SIZE, len);
+	}
+	return (end - bp->lines[line].off);
+}
+
 /*
  * mibext structures and functions.
  */
@@ -58,29 +286,62 @@ struct mibext {
 	u_char			output[UCDMAXLEN];
 	int32_t			errFix;
 	u_char			*errFixCmd;
-	int 			_fd[2];
-	int			_is_running;
+	struct ext_buf		obuf;		/* Full output. */
+	struct spawn		_cmd;
+	struct ext_buf		_obuf;		/* Output being read. */
 	uint64_t		_ticks;
-	uint64_t		_fix_ticks;
-};
-
-struct ext_msg {
-	int32_t		result;
-	u_char		output[UCDMAXLEN];
+	struct fix		_fix;
+	TAILQ_ENTRY(mibext)	_qlink;		/* Run queue link. */
+	int			_queued;
+	uint64_t		_deadline;	/* When the command became due. */
+	int32_t			persist;	/* Run by a co-process. */
+	int			_pending;	/* Co-process request sent. */
+	u_int			_seq;		/* Co-process request number. */
+	int32_t			interval;	/* Refresh interval, in ticks. */
+	int32_t			jitter;		/* Max start offset, in ticks. */
+	int32_t			retry;		/* Interval after failure. */
+	TAILQ_ENTRY(mibext)	_wlink;		/* Timer wheel link. */
+	u_char			*plugin;	/* Plugin path. */
+	struct plugin		*_plugin;
+	int			_scheduled;
+	u_int			_slot;		/* Timer wheel slot. */
+	uint64_t		_due;		/* Next run time, in ticks. */
 };
 
 TAILQ_HEAD(mibext_list, mibext);
 
 static struct mibext_list mibext_list = TAILQ_HEAD_INITIALIZER(mibext_list);
 
+/*
+ * Run queue of commands that are due but wait for a free slot, ordered by
+ * deadline. Commands with the same deadline are admitted in the order they
+ * were queued, and a command is queued again only after it has run, so
+ * every due command gets its turn before any command runs twice.
+ */
+static struct mibext_list ext_runq = TAILQ_HEAD_INITIALIZER(ext_runq);
+static int ext_running;			/* Number of running commands. */
+static int ext_queued;			/* Number of queued commands. */
+static uint32_t ext_admitted;		/* Commands admitted from the queue. */
+static uint32_t ext_wait_total;		/* Total queue wait, in ticks. */
+static uint32_t ext_wait_max;		/* Max queue wait, in ticks. */
+
 static void run_extCommands(void*);
 static void run_extFixCmds(void*);
+static void ext_admit(void);
+static void ext_coproc_free_all(void);
+
+static struct table_index ext_index =
+    TABLE_INDEX_INITIALIZER(struct mibext, index);
 
 static struct mibext *
 find_ext(int32_t idx)
 {
 	struct mibext *extp;
+	int error;
 
+	TABLE_INDEX_UPDATE(&ext_index, &mibext_list, mibext, error);
+	if (error == 0)
+		return (table_index_find(&ext_index, idx));
 	TAILQ_FOREACH(extp, &mibext_list, link) {
 		if (extp->index == idx)
 			break;
@@ -90,302 +351,749 @@ find_ext(int32_t idx)
 }
 
 /*
- * Handle timeouts when executing commands.
+ * Timer wheel of scheduled commands.
+ *
+ * A command is put into the slot of its next run time, with EXT_WHEEL_RES
+ * ticks resolution. On every extCheckInterval timer only the slots that
+ * have passed since the previous one are looked at. Commands scheduled
+ * more than a wheel rotation ahead stay in their slot until their time
+ * comes.
  */
+
+#define EXT_WHEEL_RES	100	/* 1 second. */
+#define EXT_WHEEL_SLOTS	512
+
+static struct mibext_list ext_wheel[EXT_WHEEL_SLOTS];
+static uint64_t ext_wheel_pos;		/* Last processed slot time. */
+
 static void
-extcmd_sighandler(int sig __unused)
+ext_unschedule(struct mibext *extp)
 {
 
-	_exit(127);
+	if (!extp->_scheduled)
+		return;
+	TAILQ_REMOVE(&ext_wheel[extp->_slot], extp, _wlink);
+	extp->_scheduled = 0;
+}
+
+static void
+ext_schedule(struct mibext *extp, uint64_t due)
+{
+	uint64_t pos;
+
+	ext_unschedule(extp);
+	extp->_due = due;
+	/* Round up, so the slot time is not before the due time. */
+	pos = (due + EXT_WHEEL_RES - 1) / EXT_WHEEL_RES;
+	if (pos <= ext_wheel_pos)
+		pos = ext_wheel_pos + 1;	/* Already processed. */
+	extp->_slot = pos % EXT_WHEEL_SLOTS;
+	TAILQ_INSERT_TAIL(&ext_wheel[extp->_slot], extp, _wlink);
+	extp->_scheduled = 1;
 }
 
+/*
+ * Schedule the first run of the command, at a random offset.
+ */
+static void
+ext_schedule_first(struct mibext *extp)
+{
+	uint64_t due;
+
+	due = get_ticks();
+	if (extp->jitter > 0)
+		due += arc4random_uniform(extp->jitter);
+	ext_schedule(extp, due);
+}
 
 /*
- * Run commands and collect results of programs that have already finished.
+ * Schedule the next run of the command after it has completed.
  */
 static void
-run_extCommands(void* arg __unused)
+ext_schedule_next(struct mibext *extp)
+{
+	uint64_t interval;
+
+	if (extp->result != 0 && extp->retry > 0)
+		interval = extp->retry;
+	else if (extp->interval > 0)
+		interval = extp->interval;
+	else
+		interval = ext_update_interval;
+	ext_schedule(extp, extp->_ticks + interval);
+}
+
+/*
+ * Read available output of the running command. Returns 1 on EOF and 0 if
+ * there may be more data.
+ */
+static int
+ext_read_output(void *arg)
 {
 	struct mibext *extp;
-	struct ext_msg msg;
-	uint64_t current;
-	FILE *fp;
-	int status, fd, n;
-	pid_t pid, res;
-	char null[UCDMAXLEN];
+	char buf[EXT_CHUNK_SIZE];
+	ssize_t n;
+
+	extp = (struct mibext *)arg;
+	for (;;) {
+		n = read(extp->_cmd.fd, buf, sizeof(buf));
+		if (n == -1 && errno == EINTR)
+			continue;	/* Interrupted. Try again. */
+		if (n == -1 && errno == EAGAIN)
+			return (0);	/* No data this time. */
+		if (n <= 0)
+			return (1);
+		/* Keep draining the pipe even if the output is truncated. */
+		ext_buf_append(&extp->_obuf, buf, n);
+	}
+}
 
+/*
+ * Publish the output read so far and the result.
+ */
+static void
+ext_result(struct mibext *extp, int status, int failed)
+{
+	size_t len;
+
+	ext_buf_finish(&extp->_obuf);
+	ext_buf_free(&extp->obuf);
+	extp->obuf = extp->_obuf;
+	memset(&extp->_obuf, 0, sizeof(extp->_obuf));
+
+	extp->result = status;
+	if (failed) {
+		strlcpy((char *)extp->output, "Exited abnormally!",
+		    sizeof(extp->output));
+	} else if (extp->obuf.nlines == 0) {
+		extp->output[0] = '\0';
+	} else {
+		/* extOutput is the first line. */
+		len = ext_buf_line(&extp->obuf, 0, extp->output,
+		    sizeof(extp->output) - 1);
+		extp->output[len] = '\0';
+	}
 
-	current = get_ticks();
+	/* Save the program termination time. */
+	extp->_ticks = get_ticks();
 
-	/* Run commads which are ready for running. */
+	ext_schedule_next(extp);
+}
 
-	TAILQ_FOREACH(extp, &mibext_list, link) {
-		if (!extp->command)
-			continue; /* No command specified. */
+/*
+ * The command has exited: save its results.
+ */
+static void
+ext_done(void *arg)
+{
+	struct mibext *extp;
+
+	extp = (struct mibext *)arg;
+	ext_result(extp, extp->_cmd.status, extp->_cmd.timedout);
+
+	/* Give the slot to the next command. */
+	ext_running--;
+	ext_admit();
+}
+
+static void
+ext_enqueue(struct mibext *extp, uint64_t deadline)
+{
+	struct mibext *p;
+
+	extp->_deadline = deadline;
+	TAILQ_FOREACH_REVERSE(p, &ext_runq, mibext_list, _qlink) {
+		if (p->_deadline <= deadline)
+			break;
+	}
+	if (p == NULL)
+		TAILQ_INSERT_HEAD(&ext_runq, extp, _qlink);
+	else
+		TAILQ_INSERT_AFTER(&ext_runq, p, extp, _qlink);
+	extp->_queued = 1;
+	ext_queued++;
+}
+
+static void
+ext_dequeue(struct mibext *extp)
+{
 
-		if (extp->_is_running)
-			continue; /* Command has already been running. */
+	if (!extp->_queued)
+		return;
+	TAILQ_REMOVE(&ext_runq, extp, _qlink);
+	extp->_queued = 0;
+	ext_queued--;
+}
 
-		if ((current - extp->_ticks) < ext_update_interval)
-			continue; /* ext_update_interval has not passed yet. */
+/*
+ * Start queued commands while there are free slots.
+ */
+static void
+ext_admit(void)
+{
+	struct mibext *extp;
+	uint64_t current, wait;
 
-		/* Make a pipe */
-		if (pipe(extp->_fd) == -1) {
-			syslog(LOG_ERR, "failed to pipe: %s: %m", __func__);
+	while ((extp = TAILQ_FIRST(&ext_runq)) != NULL) {
+		if (ext_max_running > 0 && ext_running >= (int)ext_max_running)
+			break;
+		ext_dequeue(extp);
+
+		current = get_ticks();
+		wait = current > extp->_deadline ? current - extp->_deadline : 0;
+		ext_admitted++;
+		ext_wait_total += wait;
+		if (wait > ext_wait_max)
+			ext_wait_max = wait;
+
+		ext_buf_free(&extp->_obuf);
+
+		if (spawn_start(&extp->_cmd, extp->command, ext_timeout) == -1) {
+			/*
+			 * Something wrong with running program.
+			 * Treat this as the program has finished
+			 * abnormaly.
+			 */
+			ext_result(extp, 127, 0);
 			continue;
 		}
-		fcntl(extp->_fd[0],F_SETFL,O_NONBLOCK);
-		fcntl(extp->_fd[1],F_SETFL,O_NONBLOCK);
+		ext_running++;
+	}
+}
 
-		/* Execute the command in the child process. */
-		pid = fork();
+/*
+ * Stop the command if it is running or waiting in the queue.
+ */
+static void
+ext_stop(struct mibext *extp)
+{
 
-		if (pid == 0) {
-			/* Close all descriptors except stdio and pipe for reading. */
-			for (fd = 3; fd < extp->_fd[1]; fd++)
-				close(fd);
+	ext_unschedule(extp);
+	ext_dequeue(extp);
+	if (extp->_cmd.pid != 0)
+		ext_running--;
+	spawn_stop(&extp->_cmd);
+	ext_buf_free(&extp->_obuf);
+	extp->_pending = 0;	/* A co-process reply will be ignored. */
+	if (extp->_plugin != NULL) {
+		plugin_close(extp->_plugin);
+		extp->_plugin = NULL;
+	}
+}
 
-			/* Fork again. */
-			if ((pid = fork()) < 0) {
-				syslog(LOG_ERR, "Can't fork: %s: %m", __func__);
-				_exit(127);
-			}
+/*
+ * Persistent co-processes.
+ *
+ * extTable entries with extPersist set are not run one by one. Instead the
+ * command is started once and kept running, and all entries with the same
+ * command share it. For every check the agent writes to the co-process
+ * stdin the line
+ *
+ *	run <extNames>
+ *
+ * and the co-process replies on its stdout with the exit status line
+ * followed by the output lines and a line with a single dot. Output lines
+ * starting with a dot are prefixed with another one. Replies are expected
+ * in the order of requests.
+ *
+ * A co-process that exits, breaks the protocol or does not reply within
+ * extTimeout is killed, its pending checks fail, and it is restarted with
+ * exponential backoff.
+ */
 
-			if (pid == 0) { /* grandchild */
-				msg.output[0] = '\0';
+#define EXT_COPROC_LINE		1024	/* Max reply line length. */
+#define EXT_COPROC_BACKOFF_MIN	100	/* 1 second. */
+#define EXT_COPROC_BACKOFF_MAX	30000	/* 5 minutes. */
 
-				/* Become process group leader. */
-				setpgid(0, 0);
+struct ext_req {
+	TAILQ_ENTRY(ext_req)	link;
+	int32_t			index;		/* extIndex of the entry. */
+	u_int			seq;		/* Entry request number. */
+	uint64_t		sent;		/* Time sent, in ticks. */
+};
 
-				/* Trap commands that timeout. */
-				signal(SIGALRM, extcmd_sighandler);
- 				alarm(ext_timeout);
+TAILQ_HEAD(ext_req_list, ext_req);
 
-				/* Run the command. */
-				fp = popen((char*) extp->command, "r");
-				if (fp == NULL) {
-					syslog(LOG_ERR, "popen failed: %s: %m",
-					    __func__);
-					/* Send empty line to parent and exit. */
-					msg.result = 127;
-					write(extp->_fd[1], (char*) &msg,
-					    sizeof(msg));
-					_exit(127);
-				}
+struct ext_coproc {
+	TAILQ_ENTRY(ext_coproc)	link;
+	u_char			*command;
+	struct spawn		sp;
+	struct ext_req_list	reqs;		/* Requests waiting for reply. */
+	char			line[EXT_COPROC_LINE];
+	size_t			linelen;
+	int			inreply;	/* Status line has been read. */
+	int			status;		/* Status of the reply. */
+	u_int			failures;	/* Successive failures. */
+	uint64_t		restart;	/* Do not start before. */
+	int			used;		/* Used by some entry. */
+};
 
-				/* Read the first line to output buffer. */
-				if (fgets((char*) msg.output, sizeof(msg.output), fp) != NULL) { /* we have some output */
-					int	end;
+TAILQ_HEAD(ext_coproc_list, ext_coproc);
 
-					/* Chop 'end of line'. */
-					end = strlen((char*) msg.output) - 1;
-					if ((end >= 0) && (msg.output[end] == '\n'))
-						msg.output[end] = '\0';
+static struct ext_coproc_list ext_coproc_list =
+    TAILQ_HEAD_INITIALIZER(ext_coproc_list);
 
-					/* Just skip other lines. */
-					while (fgets(null, sizeof(null), fp) != NULL);
-				}
+static struct mibext *
+ext_req_entry(const struct ext_req *req)
+{
+	struct mibext *extp;
 
-				status = pclose(fp);
-				msg.result = WEXITSTATUS(status);
-				/* Send the result to the parent. */
-				write(extp->_fd[1], (char*) &msg, sizeof(msg));
-				close(extp->_fd[1]);
-				_exit(msg.result);
-			} else { /* Parent of grandchild. */
-				_exit(0);
-			}
-		}
+	extp = find_ext(req->index);
+	if (extp == NULL || !extp->_pending || extp->_seq != req->seq)
+		return (NULL);	/* The entry has changed since. */
+	return (extp);
+}
+
+/*
+ * Stop the co-process, fail its pending requests and schedule a restart.
+ */
+static void
+ext_coproc_fail(struct ext_coproc *cp)
+{
+	struct ext_req *req;
+	struct mibext *extp;
+	uint64_t backoff;
+	u_int i;
 
-		/* Parent (bsnmpd process). */
+	spawn_stop(&cp->sp);
 
-		if (pid == -1) {
-			syslog(LOG_ERR, "Can't fork: %s: %m", __func__);
-			close(extp->_fd[0]);
-			close(extp->_fd[1]);
-			continue;
+	while ((req = TAILQ_FIRST(&cp->reqs)) != NULL) {
+		TAILQ_REMOVE(&cp->reqs, req, link);
+		if ((extp = ext_req_entry(req)) != NULL) {
+			extp->_pending = 0;
+			spawn_stats_end(&extp->_cmd.stats, 0, NULL);
+			ext_result(extp, 127, 1);
 		}
+		free(req);
+	}
+	cp->linelen = 0;
+	cp->inreply = 0;
+
+	backoff = EXT_COPROC_BACKOFF_MIN;
+	for (i = 0; i < cp->failures && backoff < EXT_COPROC_BACKOFF_MAX; i++)
+		backoff *= 2;
+	if (backoff > EXT_COPROC_BACKOFF_MAX)
+		backoff = EXT_COPROC_BACKOFF_MAX;
+	cp->failures++;
+	cp->restart = get_ticks() + backoff;
+
+	syslog(LOG_WARNING, "co-process `%s' failed, restarting in %ju "
+	    "seconds", cp->command, (uintmax_t)(backoff / 100));
+}
 
-		/* Close pipe for writing. */
-		close(extp->_fd[1]);
+/*
+ * Process a reply line.
+ */
+static int
+ext_coproc_line(struct ext_coproc *cp, char *line, size_t len)
+{
+	struct ext_req *req;
+	struct mibext *extp;
+	char *end;
+	long status;
+
+	req = TAILQ_FIRST(&cp->reqs);
+	if (req == NULL)
+		return (-1);	/* Nobody asked. */
+	extp = ext_req_entry(req);
+
+	if (!cp->inreply) {
+		line[len] = '\0';
+		status = strtol(line, &end, 10);
+		if (len == 0 || *end != '\0' || status < 0 ||
+		    status > INT32_MAX)
+			return (-1);
+		cp->status = status;
+		cp->inreply = 1;
+		return (0);
+	}
 
-		/* Wait for child. */
-		for (;;) {
-			res = waitpid(pid, &status, 0);
-			if (res == -1 && errno == EINTR)
-				continue;
+	if (len == 1 && line[0] == '.') {
+		/* End of the reply. */
+		TAILQ_REMOVE(&cp->reqs, req, link);
+		free(req);
+		cp->inreply = 0;
+		cp->failures = 0;
+		if (extp != NULL) {
+			extp->_pending = 0;
+			spawn_stats_end(&extp->_cmd.stats, 0, NULL);
+			ext_result(extp, cp->status, 0);
+		}
+		return (0);
+	}
 
-			if (res == -1) {
-				syslog(LOG_ERR, "waitpid failed: %s: %m",
-				    __func__);
-				break;
+	if (line[0] == '.') {
+		line++;
+		len--;
+	}
+	if (extp != NULL) {
+		ext_buf_append(&extp->_obuf, line, len);
+		ext_buf_append(&extp->_obuf, "\n", 1);
+	}
+	return (0);
+}
+
+/*
+ * Read co-process replies. Returns 1 on EOF.
+ */
+static int
+ext_coproc_read(void *arg)
+{
+	struct ext_coproc *cp;
+	char buf[EXT_CHUNK_SIZE], *p, *eol;
+	ssize_t n;
+	size_t len;
+
+	cp = (struct ext_coproc *)arg;
+	for (;;) {
+		n = read(cp->sp.fd, buf, sizeof(buf));
+		if (n == -1 && errno == EINTR)
+			continue;	/* Interrupted. Try again. */
+		if (n == -1 && errno == EAGAIN)
+			return (0);	/* No data this time. */
+		if (n <= 0)
+			return (1);
+
+		for (p = buf; p < buf + n; p += len) {
+			eol = memchr(p, '\n', buf + n - p);
+			len = (eol != NULL) ? (size_t)(eol - p) :
+			    (size_t)(buf + n - p);
+			/* Too long lines are cut. */
+			if (len > sizeof(cp->line) - 1 - cp->linelen) {
+				memcpy(cp->line + cp->linelen, p,
+				    sizeof(cp->line) - 1 - cp->linelen);
+				cp->linelen = sizeof(cp->line) - 1;
 			} else {
-				/* Get the exit code returned from the program. */
-				status = WEXITSTATUS(status);
+				memcpy(cp->line + cp->linelen, p, len);
+				cp->linelen += len;
+			}
+			if (eol == NULL)
+				break;
+			len++;
+			if (ext_coproc_line(cp, cp->line, cp->linelen) == -1) {
+				syslog(LOG_ERR, "co-process `%s' protocol "
+				    "error: %s", cp->command, __func__);
+				ext_coproc_fail(cp);
+				return (1);
 			}
+			cp->linelen = 0;
+		}
+	}
+}
 
-			if (status != 0) {
-				/*
-				 * Something wrong with running program.
-				 * Treat this as the program has finished
-				 * abnormaly.
-				 */
+/*
+ * The co-process has exited.
+ */
+static void
+ext_coproc_done(void *arg)
+{
 
-				/* Save the program termination time. */
-				extp->_ticks = get_ticks();
+	ext_coproc_fail((struct ext_coproc *)arg);
+}
 
-				/* Close the pipe for reading. */
-				close(extp->_fd[0]);
+static struct ext_coproc *
+ext_coproc_get(const u_char *command)
+{
+	struct ext_coproc *cp;
 
-				/* Fill extp data. */
-				extp->result = 127;
-				extp->output[0] = '\0';
-				extp->_is_running = 0;
-			} else { /*  Program is running. */
-				extp->_is_running = 1;
-			}
-			break;
-		}
+	TAILQ_FOREACH(cp, &ext_coproc_list, link) {
+		if (strcmp((const char *)cp->command,
+		    (const char *)command) == 0)
+			return (cp);
 	}
 
-	/* Collect data of finished commands. */
+	cp = malloc(sizeof(*cp));
+	if (cp == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (NULL);
+	}
+	memset(cp, 0, sizeof(*cp));
+	cp->command = (u_char *)strdup((const char *)command);
+	if (cp->command == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		free(cp);
+		return (NULL);
+	}
+	TAILQ_INIT(&cp->reqs);
+	spawn_init(&cp->sp, ext_coproc_read, ext_coproc_done, cp);
+	cp->sp.flags |= SPAWN_DUPLEX;
+	TAILQ_INSERT_TAIL(&ext_coproc_list, cp, link);
+	return (cp);
+}
 
-	TAILQ_FOREACH(extp, &mibext_list, link) {
-		if (!extp->_is_running)
-			break; /* Programm is not running */
+static void
+ext_coproc_free(struct ext_coproc *cp)
+{
+	struct ext_req *req;
 
-		for (;;) {
-			n = read(extp->_fd[0], (char*) &msg, sizeof(msg));
+	TAILQ_REMOVE(&ext_coproc_list, cp, link);
+	spawn_stop(&cp->sp);
+	while ((req = TAILQ_FIRST(&cp->reqs)) != NULL) {
+		TAILQ_REMOVE(&cp->reqs, req, link);
+		free(req);
+	}
+	free(cp->command);
+	free(cp);
+}
 
-			if (n == -1 && errno == EINTR)
-				continue;	/* Interrupted. Try again. */
+static void
+ext_coproc_free_all(void)
+{
+	struct ext_coproc *cp;
 
-			if (n == -1 && errno == EAGAIN)
-				break;		/* No data this time. */
+	while ((cp = TAILQ_FIRST(&ext_coproc_list)) != NULL)
+		ext_coproc_free(cp);
+}
 
-			if (n != sizeof(msg)) {
-				/*
-				 * Read returned something wrong. Mark the
-				 * command as abnormally finished
-				 */
-				extp->result = 127;
-				strncpy((char*) extp->output, "Exited abnormally!",
-				    sizeof(extp->output) - 1);
-			} else {
-				extp->result = msg.result;
-				strncpy((char *)extp->output, (char *)msg.output,
-				    sizeof(extp->output) - 1);
-			}
+/*
+ * Send the check request to the co-process, starting it if needed.
+ */
+static void
+ext_coproc_run(struct ext_coproc *cp, struct mibext *extp)
+{
+	struct ext_req *req;
+	char buf[UCDMAXLEN + 8];
+	int len;
+
+	if (cp->sp.pid == 0) {
+		if (get_ticks() < cp->restart) {
+			/* Backoff. */
+			ext_schedule(extp, cp->restart);
+			return;
+		}
+		if (spawn_start(&cp->sp, cp->command, 0) == -1) {
+			ext_coproc_fail(cp);
+			ext_schedule(extp, cp->restart);
+			return;
+		}
+	}
 
-			extp->_is_running = 0;
+	if (extp->names != NULL)
+		len = snprintf(buf, sizeof(buf), "run %s\n", extp->names);
+	else
+		len = snprintf(buf, sizeof(buf), "run %d\n", extp->index);
+	if (len < 0 || (size_t)len >= sizeof(buf)) {
+		syslog(LOG_ERR, "extNames is too long: %s", __func__);
+		ext_result(extp, 127, 1);
+		return;
+	}
 
-			close(extp->_fd[0]);
+	req = malloc(sizeof(*req));
+	if (req == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		ext_result(extp, 127, 1);
+		return;
+	}
+	if (send(cp->sp.fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len) {
+		/* The co-process is not reading requests. */
+		syslog(LOG_ERR, "failed to send request to `%s': %s: %m",
+		    cp->command, __func__);
+		free(req);
+		ext_coproc_fail(cp);
+		extp->_cmd.stats.failures++;
+		ext_result(extp, 127, 1);
+		return;
+	}
+	spawn_stats_start(&extp->_cmd.stats);
+
+	ext_buf_free(&extp->_obuf);
+	extp->_pending = 1;
+	extp->_seq++;
+	req->index = extp->index;
+	req->seq = extp->_seq;
+	req->sent = get_ticks();
+	TAILQ_INSERT_TAIL(&cp->reqs, req, link);
+}
 
-			/* Save the program termination time. */
-			extp->_ticks = get_ticks();
+/*
+ * Stop co-processes that are not used by any entry after configuration
+ * changes.
+ */
+static void
+ext_coproc_gc(void)
+{
+	struct ext_coproc *cp, *tcp;
+	struct mibext *extp;
 
-			break;
+	TAILQ_FOREACH(cp, &ext_coproc_list, link)
+		cp->used = 0;
+	TAILQ_FOREACH(extp, &mibext_list, link) {
+		if (!extp->persist || extp->command == NULL)
+			continue;
+		TAILQ_FOREACH(cp, &ext_coproc_list, link) {
+			if (strcmp((const char *)cp->command,
+			    (const char *)extp->command) == 0) {
+				cp->used = 1;
+				break;
+			}
 		}
 	}
+	TAILQ_FOREACH_SAFE(cp, &ext_coproc_list, link, tcp) {
+		if (!cp->used)
+			ext_coproc_free(cp);
+	}
 }
 
 /*
- * Run fix commands.
+ * Check co-process timeouts.
  */
 static void
-run_extFixCmds(void* arg __unused)
+ext_coproc_check(void)
 {
+	struct ext_coproc *cp, *tcp;
+	struct ext_req *req;
 	struct mibext *extp;
 	uint64_t current;
-	pid_t pid, res;
-	int status, fd;
 
 	current = get_ticks();
 
-	/* Run commads if needed. */
+	TAILQ_FOREACH_SAFE(cp, &ext_coproc_list, link, tcp) {
+		req = TAILQ_FIRST(&cp->reqs);
+		if (req != NULL && ext_timeout > 0 &&
+		    current - req->sent > (uint64_t)ext_timeout * 100) {
+			syslog(LOG_WARNING, "co-process `%s' has not replied "
+			    "in %u seconds", cp->command, ext_timeout);
+			if ((extp = ext_req_entry(req)) != NULL)
+				extp->_cmd.stats.timeouts++;
+			ext_coproc_fail(cp);
+		}
+	}
+}
 
-	TAILQ_FOREACH(extp, &mibext_list, link) {
-		if (!extp->errFix)
-			continue;	/* No fix. */
+/*
+ * The plugin check has completed.
+ */
+static void
+ext_plugin_done(void *arg, int result, const char *output, int timedout,
+    const struct rusage *ru)
+{
+	struct mibext *extp;
+
+	extp = (struct mibext *)arg;
+	spawn_stats_end(&extp->_cmd.stats, timedout, ru);
+	ext_buf_free(&extp->_obuf);
+	ext_buf_append(&extp->_obuf, output, strlen(output));
+	ext_result(extp, result, timedout);
+}
 
-		if (!extp->errFixCmd)
-			continue;	/* No command specified. */
+/*
+ * Run the plugin check, loading the plugin on the first run. extCommand
+ * is passed to the plugin as arguments.
+ */
+static void
+ext_plugin_run(struct mibext *extp)
+{
 
-		if (extp->result == 0)
-			continue;	/* Checked command exited normaly, no need for fix. */
+	if (extp->_plugin == NULL) {
+		extp->_plugin = plugin_open(extp->plugin, extp->command,
+		    ext_plugin_done, extp);
+	}
+	if (extp->_plugin == NULL ||
+	    plugin_run(extp->_plugin, ext_timeout) == -1) {
+		extp->_cmd.stats.failures++;
+		ext_result(extp, 127, 1);
+		return;
+	}
+	/* The result is passed back later, from the main loop. */
+	spawn_stats_start(&extp->_cmd.stats);
+}
 
-		if ((current - extp->_fix_ticks) < ext_update_interval)
-			continue;  /* ext_update_interval has not passed yet. */
+/*
+ * Start the command whose time has come.
+ */
+static void
+ext_fire(struct mibext *extp)
+{
+	struct ext_coproc *cp;
 
-		/* Execute the command in the child process. */
-		pid = fork();
+	if (extp->plugin) {
+		ext_plugin_run(extp);
+		return;
+	}
 
-		if (pid == 0) {
-			/* Close all descriptors except stdio. */
-			for (fd = 3; fd <= getdtablesize(); fd++)
-				close(fd);
+	if (!extp->command)
+		return; /* No command specified. */
 
-			/* Fork again. */
-			if ((pid = fork()) < 0) {
-				syslog(LOG_ERR, "Can't fork: %s: %m", __func__);
-				_exit(127);
-			}
+	if (extp->persist) {
+		if ((cp = ext_coproc_get(extp->command)) == NULL) {
+			ext_result(extp, 127, 1);
+			return;
+		}
+		ext_coproc_run(cp, extp);
+		return;
+	}
 
-			if (pid == 0) { /* grandchild */
-				/* Become process group leader. */
-				setpgid(0, 0);
+	/* Run it when there is a free slot. */
+	ext_enqueue(extp, extp->_due);
+}
 
-				/* Trap commands that timeout. */
-				signal(SIGALRM, extcmd_sighandler);
-				alarm(ext_timeout);
+/*
+ * Run commands that are due. Results are collected by ext_done() when
+ * they exit, and the next run is scheduled then.
+ */
+static void
+run_extCommands(void* arg __unused)
+{
+	struct mibext *extp, *textp;
+	struct mibext_list *slot;
+	uint64_t current, pos, end;
 
-				/* Run the command. */
-				status = system((char*) extp->errFixCmd);
-				if (status != 0) {
-					syslog(LOG_WARNING,
-					    "command `%s' has retuned status %d",
-					    extp->errFixCmd, WEXITSTATUS(status));
-				}
-				_exit(WEXITSTATUS(status));
-			}
+	current = get_ticks();
 
-			/* Parent of grandchild. */
-			_exit(0);
+	/* Go through the wheel slots that have passed since the last time. */
+	end = current / EXT_WHEEL_RES;
+	pos = ext_wheel_pos + 1;
+	if (end >= pos + EXT_WHEEL_SLOTS)
+		pos = end - EXT_WHEEL_SLOTS + 1;
+	for (; pos <= end; pos++) {
+		/* Commands rescheduled meanwhile go to the next slots. */
+		ext_wheel_pos = pos;
+		slot = &ext_wheel[pos % EXT_WHEEL_SLOTS];
+		TAILQ_FOREACH_SAFE(extp, slot, _wlink, textp) {
+			if (extp->_due > current)
+				continue; /* Next rotation. */
+			ext_unschedule(extp);
+			ext_fire(extp);
 		}
+	}
 
-		/* Parent. */
+	ext_admit();
+	ext_coproc_check();
+}
 
-		if (pid == -1) {
-			syslog(LOG_ERR, "Can't fork: %s: %m", __func__);
-			continue;
-		}
+/*
+ * Request fixes of failed commands.
+ */
+static void
+run_extFixCmds(void* arg __unused)
+{
+	struct mibext *extp;
 
-		/* Wait for child. */
-		for (;;) {
-			res = waitpid(pid, &status, 0);
-			if (res == -1 && errno == EINTR)
-				continue;
-			if (res == -1)
-				syslog(LOG_ERR, "failed to waitpid: %s: %m", __func__);
-			break;
-		}
-		extp->_fix_ticks = get_ticks();
+	TAILQ_FOREACH(extp, &mibext_list, link) {
+		if (extp->errFix && extp->errFixCmd && extp->result != 0)
+			fix_request(&extp->_fix, extp->errFixCmd);
+		else
+			fix_reset(&extp->_fix);
 	}
 }
 
-int
-op_extTable(struct snmp_context * context __unused, struct snmp_value * value,
+static int
+do_extTable(struct snmp_context * context __unused, struct snmp_value * value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	struct mibext *extp = NULL;
 	asn_subid_t which;
-	int ret;
+	int error, ret;
 
 	which = value->var.subs[sub - 1];
 
 	switch (op) {
 	case SNMP_OP_GETNEXT:
-		extp = NEXT_OBJECT_INT(&mibext_list, &value->var, sub);
+		TABLE_INDEX_UPDATE(&ext_index, &mibext_list, mibext, error);
+		if (error == 0)
+			extp = table_index_next(&ext_index, &value->var, sub);
+		else
+			extp = NEXT_OBJECT_INT(&mibext_list, &value->var, sub);
 		if (extp == NULL)
 			return (SNMP_ERR_NOSUCHNAME);
 		value->var.len = sub + 1;
@@ -414,18 +1122,19 @@ op_extTable(struct snmp_context * context __unused, struct snmp_value * value,
 				}
 				memset(extp, 0, sizeof(*extp));
 				extp->index = value->var.subs[sub];
+				spawn_init(&extp->_cmd, ext_read_output,
+				    ext_done, extp);
+				fix_init(&extp->_fix);
 				INSERT_OBJECT_INT(extp, &mibext_list);
+				table_index_changed(&ext_index);
 			} else {
 				/*
 				 * We have already had some command defined
-				 * under this index. Check if the command is
-				 * running to close our end of pipe.
+				 * under this index. Stop it if it is running.
 				 */
-				if (extp->_is_running) {
-					close(extp->_fd[0]);
-					extp->_is_running = 0;
-				}
+				ext_stop(extp);
 			}
+			ext_schedule_first(extp);
 			ret = string_save(value, context, -1, &extp->names);
 			return (ret);
 
@@ -433,7 +1142,12 @@ op_extTable(struct snmp_context * context __unused, struct snmp_value * value,
 			extp = find_ext(value->var.subs[sub]);
 			if (extp == NULL)
 				return (SNMP_ERR_NOT_WRITEABLE);
+			/* Stop the old command. */
+			ext_stop(extp);
 			ret = string_save(value, context, -1, &extp->command);
+			if (extp->persist)
+				ext_coproc_gc();
+			ext_schedule_first(extp);
 			return (ret);
 
 		case LEAF_extErrFix:
@@ -443,6 +1157,62 @@ op_extTable(struct snmp_context * context __unused, struct snmp_value * value,
 			extp->errFix = value->v.integer;
 			return SNMP_ERR_NOERROR;
 
+		case LEAF_extPersist:
+			extp = find_ext(value->var.subs[sub]);
+			if (extp == NULL)
+				return (SNMP_ERR_NOT_WRITEABLE);
+			if (value->v.integer != 0 && value->v.integer != 1)
+				return (SNMP_ERR_WRONG_VALUE);
+			if (extp->persist != value->v.integer) {
+				ext_stop(extp);
+				extp->persist = value->v.integer;
+				ext_coproc_gc();
+				ext_schedule_first(extp);
+			}
+			return SNMP_ERR_NOERROR;
+
+		case LEAF_extPlugin:
+			extp = find_ext(value->var.subs[sub]);
+			if (extp == NULL)
+				return (SNMP_ERR_NOT_WRITEABLE);
+			ext_stop(extp);
+			ret = string_save(value, context, -1, &extp->plugin);
+			ext_schedule_first(extp);
+			return (ret);
+
+		case LEAF_extInterval:
+			extp = find_ext(value->var.subs[sub]);
+			if (extp == NULL)
+				return (SNMP_ERR_NOT_WRITEABLE);
+			if (value->v.integer < 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			extp->interval = value->v.integer;
+			if (extp->_scheduled && extp->_ticks != 0)
+				ext_schedule_next(extp);
+			return SNMP_ERR_NOERROR;
+
+		case LEAF_extJitter:
+			extp = find_ext(value->var.subs[sub]);
+			if (extp == NULL)
+				return (SNMP_ERR_NOT_WRITEABLE);
+			if (value->v.integer < 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			extp->jitter = value->v.integer;
+			if (extp->_scheduled && extp->_ticks == 0)
+				ext_schedule_first(extp);
+			return SNMP_ERR_NOERROR;
+
+		case LEAF_extRetryInterval:
+			extp = find_ext(value->var.subs[sub]);
+			if (extp == NULL)
+				return (SNMP_ERR_NOT_WRITEABLE);
+			if (value->v.integer < 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			extp->retry = value->v.integer;
+			if (extp->_scheduled && extp->_ticks != 0)
+				ext_schedule_next(extp);
+			return SNMP_ERR_NOERROR;
+
 		case LEAF_extErrFixCmd:
 			extp = find_ext(value->var.subs[sub]);
 			if (extp == NULL)
@@ -495,6 +1265,62 @@ op_extTable(struct snmp_context * context __unused, struct snmp_value * value,
 		ret = string_get(value, extp->errFixCmd, -1);
 		break;
 
+	case LEAF_extOutputLines:
+		value->v.integer = extp->obuf.nlines;
+		break;
+
+	case LEAF_extOutputTruncated:
+		value->v.integer = extp->obuf.truncated;
+		break;
+
+	case LEAF_extPersist:
+		value->v.integer = extp->persist;
+		break;
+
+	case LEAF_extPlugin:
+		ret = string_get(value, extp->plugin, -1);
+		break;
+
+	case LEAF_extInterval:
+		value->v.integer = extp->interval;
+		break;
+
+	case LEAF_extJitter:
+		value->v.integer = extp->jitter;
+		break;
+
+	case LEAF_extRetryInterval:
+		value->v.integer = extp->retry;
+		break;
+
+	case LEAF_extRuns:
+	case LEAF_extTimeouts:
+	case LEAF_extSpawnFailures:
+	case LEAF_extLastRuntime:
+	case LEAF_extAvgRuntime:
+	case LEAF_extMaxRuntime:
+	case LEAF_extUserTime:
+	case LEAF_extSystemTime:
+	case LEAF_extLastStart:
+	case LEAF_extLastEnd:
+		ret = spawn_stats_get(&extp->_cmd.stats, which - LEAF_extRuns,
+		    value);
+		break;
+
+	case LEAF_extFixRuns:
+	case LEAF_extFixTimeouts:
+	case LEAF_extFixSpawnFailures:
+	case LEAF_extFixLastRuntime:
+	case LEAF_extFixAvgRuntime:
+	case LEAF_extFixMaxRuntime:
+	case LEAF_extFixUserTime:
+	case LEAF_extFixSystemTime:
+	case LEAF_extFixLastStart:
+	case LEAF_extFixLastEnd:
+		ret = spawn_stats_get(&extp->_fix.stats,
+		    which - LEAF_extFixRuns, value);
+		break;
+
 	default:
 		ret = SNMP_ERR_RES_UNAVAIL;
 		break;
@@ -503,12 +1329,177 @@ op_extTable(struct snmp_context * context __unused, struct snmp_value * value,
 	return (ret);
 };
 
+OPSTAT_HANDLER(extTable, OPSTAT_EXTTABLE)
+
+/*
+ * Find the output line following (idx, line) in the lexicographical order.
+ */
+static struct mibext *
+next_ext_line(const struct asn_oid *oid, u_int sub, u_int *linep)
+{
+	struct mibext *extp;
+	u_int line;
+
+	if (oid->len - sub == 0) {
+		extp = TAILQ_FIRST(&mibext_list);
+		line = 0;
+	} else {
+		if (oid->subs[sub] > INT32_MAX)
+			return (NULL);
+		TAILQ_FOREACH(extp, &mibext_list, link) {
+			if (extp->index >= (int32_t)oid->subs[sub])
+				break;
+		}
+		if (extp == NULL)
+			return (NULL);
+		if (extp->index > (int32_t)oid->subs[sub])
+			line = 0;
+		else if (oid->len - sub == 1)
+			line = 0;
+		else if (oid->subs[sub + 1] >= extp->obuf.nlines)
+			line = extp->obuf.nlines; /* Go to the next entry. */
+		else
+			line = oid->subs[sub + 1];
+	}
+
+	for (; extp != NULL; extp = TAILQ_NEXT(extp, link), line = 0) {
+		if (line < extp->obuf.nlines) {
+			*linep = line;
+			return (extp);
+		}
+	}
+	return (NULL);
+}
+
+int
+op_extOutputTable(struct snmp_context * context __unused,
+	struct snmp_value * value, u_int sub, u_int iidx __unused,
+	enum snmp_op op)
+{
+	struct mibext *extp = NULL;
+	asn_subid_t which;
+	u_char *line;
+	u_int lineno;
+	int ret;
+
+	which = value->var.subs[sub - 1];
+
+	switch (op) {
+	case SNMP_OP_GETNEXT:
+		extp = next_ext_line(&value->var, sub, &lineno);
+		if (extp == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		value->var.len = sub + 2;
+		value->var.subs[sub] = extp->index;
+		value->var.subs[sub + 1] = lineno + 1;
+		break;
+
+	case SNMP_OP_GET:
+		if (value->var.len - sub != 2)
+			return (SNMP_ERR_NOSUCHNAME);
+		if (value->var.subs[sub] > INT32_MAX)
+			return (SNMP_ERR_NOSUCHNAME);
+		extp = find_ext(value->var.subs[sub]);
+		if (extp == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		lineno = value->var.subs[sub + 1];
+		if (lineno == 0 || lineno > extp->obuf.nlines)
+			return (SNMP_ERR_NOSUCHNAME);
+		lineno--;
+		break;
+
+	case SNMP_OP_SET:
+		return (SNMP_ERR_NOT_WRITEABLE);
+
+	case SNMP_OP_ROLLBACK:
+	case SNMP_OP_COMMIT:
+		return (SNMP_ERR_NOERROR);
+
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+
+	switch (which) {
+	case LEAF_extOutputLineNo:
+		value->v.integer = lineno + 1;
+		ret = SNMP_ERR_NOERROR;
+		break;
+
+	case LEAF_extOutputLine:
+		line = malloc(extp->obuf.lines[lineno].len + 1);
+		if (line == NULL) {
+			syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+			return (SNMP_ERR_RES_UNAVAIL);
+		}
+		ext_buf_line(&extp->obuf, lineno, line,
+		    extp->obuf.lines[lineno].len);
+		ret = string_get(value, line, extp->obuf.lines[lineno].len);
+		free(line);
+		break;
+
+	default:
+		ret = SNMP_ERR_RES_UNAVAIL;
+		break;
+	}
+
+	return (ret);
+}
+
+int
+op_extQueue(struct snmp_context * context __unused, struct snmp_value * value,
+	u_int sub, u_int iidx __unused, enum snmp_op op)
+{
+	asn_subid_t which;
+
+	which = value->var.subs[sub - 1];
+
+	switch (op) {
+	case SNMP_OP_GET:
+		break;
+	case SNMP_OP_GETNEXT:
+	case SNMP_OP_ROLLBACK:
+	case SNMP_OP_COMMIT:
+		return (SNMP_ERR_NOERROR);
+	case SNMP_OP_SET:
+		return (SNMP_ERR_NOT_WRITEABLE);
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+
+	switch (which) {
+	case LEAF_extRunning:
+		value->v.integer = ext_running;
+		break;
+	case LEAF_extQueueDepth:
+		value->v.integer = ext_queued;
+		break;
+	case LEAF_extQueueAdmitted:
+		value->v.uint32 = ext_admitted;
+		break;
+	case LEAF_extQueueWaitTotal:
+		value->v.uint32 = ext_wait_total;
+		break;
+	case LEAF_extQueueWaitMax:
+		value->v.integer = ext_wait_max > INT32_MAX ?
+		    INT32_MAX : ext_wait_max;
+		break;
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+	return (SNMP_ERR_NOERROR);
+}
+
 /*
  * mibext initialization.
  */
 void
 mibext_init(void)
 {
+	int i;
+
+	for (i = 0; i < EXT_WHEEL_SLOTS; i++)
+		TAILQ_INIT(&ext_wheel[i]);
+	ext_wheel_pos = get_ticks() / EXT_WHEEL_RES;
 
 	register_ext_check_interval_timer(run_extCommands);
 	register_ext_check_interval_timer(run_extFixCmds);
@@ -524,9 +1515,14 @@ mibext_free(void)
 
 	while ((extp = TAILQ_FIRST(&mibext_list)) != NULL) {
 		TAILQ_REMOVE (&mibext_list, extp, link);
+		table_index_changed(&ext_index);
+		ext_stop(extp);
+		fix_cancel(&extp->_fix);
+		ext_buf_free(&extp->obuf);
 		free(extp->names);
 		free(extp->command);
 		free(extp->errFixCmd);
+		free(extp->plugin);
 		free (extp);
 	}
 }
@@ -534,6 +1530,14 @@ mibext_free(void)
 void
 mibext_fini(void)
 {
+	struct ext_chunk *c;
 
 	mibext_free();
+	table_index_free(&ext_index);
+	ext_coproc_free_all();
+	while ((c = ext_free_chunks) != NULL) {
+		ext_free_chunks = c->next;
+		free(c);
+	}
+	ext_chunks_total = 0;
 }
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "snmp_ucd.h"
+
+/*
+ * Sample history.
+ *
+ * A metric keeps its last histSamples samples in a ring, sample number n
+ * (counted from 1 since the metric was created) in slot (n - 1) % size.
+ * The collectors add a sample each time they update the value. A metric
+ * that is no longer referenced (e.g. a disk device went away) is kept
+ * until its newest sample is older than the history period, so the
+ * poller still gets the samples taken before it disappeared.
+ */
+
+struct hist_sample {
+	uint32_t	time;		/* Seconds since the Epoch. */
+	int32_t		value;
+};
+
+struct hist_metric {
+	TAILQ_ENTRY(hist_metric) link;
+	int32_t			index;
+	u_char			name[UCDMAXLEN];
+	u_int			refs;
+	struct hist_sample	*ring;
+	u_int			size;		/* Slots in ring. */
+	u_int			nsamples;	/* Samples held, <= size. */
+	uint32_t		last;		/* Number of the newest sample. */
+};
+
+TAILQ_HEAD(hist_list, hist_metric);
+
+static struct hist_list hist_list = TAILQ_HEAD_INITIALIZER(hist_list);
+
+static int32_t hist_next_index = 1;
+
+static struct table_index hist_index =
+    TABLE_INDEX_INITIALIZER(struct hist_metric, index);
+
+static void
+hist_free(struct hist_metric *hp)
+{
+
+	TAILQ_REMOVE(&hist_list, hp, link);
+	table_index_changed(&hist_index);
+	free(hp->ring);
+	free(hp);
+}
+
+static struct hist_metric *
+find_hist(int32_t idx)
+{
+	struct hist_metric *hp;
+	int error;
+
+	TABLE_INDEX_UPDATE(&hist_index, &hist_list, hist_metric, error);
+	if (error == 0)
+		return (table_index_find(&hist_index, idx));
+	TAILQ_FOREACH(hp, &hist_list, link) {
+		if (hp->index == idx)
+			break;
+	}
+
+	return (hp);
+}
+
+/*
+ * Resize the ring to hist_samples slots, keeping the newest samples.
+ */
+static int
+hist_resize(struct hist_metric *hp)
+{
+	struct hist_sample *ring;
+	uint32_t n;
+
+	if (hp->size == hist_samples)
+		return (0);
+
+	ring = NULL;
+	if (hist_samples > 0) {
+		ring = calloc(hist_samples, sizeof(*ring));
+		if (ring == NULL) {
+			syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+			return (-1);
+		}
+	}
+	if (hp->nsamples > hist_samples)
+		hp->nsamples = hist_samples;
+	for (n = hp->last - hp->nsamples + 1; n <= hp->last; n++)
+		ring[(n - 1) % hist_samples] = hp->ring[(n - 1) % hp->size];
+	free(hp->ring);
+	hp->ring = ring;
+	hp->size = hist_samples;
+	return (0);
+}
+
+/*
+ * Find the metric by name or create it, and take a reference.
+ */
+struct hist_metric *
+hist_metric_get(const char *name)
+{
+	struct hist_metric *hp;
+
+	TAILQ_FOREACH(hp, &hist_list, link) {
+		if (strcmp((const char *)hp->name, name) == 0) {
+			hp->refs++;
+			return (hp);
+		}
+	}
+
+	hp = malloc(sizeof(*hp));
+	if (hp == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (NULL);
+	}
+	memset(hp, 0, sizeof(*hp));
+	hp->index = hist_next_index++;
+	strlcpy((char *)hp->name, name, sizeof(hp->name));
+	hp->refs = 1;
+	/* Indexes only grow, so the list stays sorted. */
+	TAILQ_INSERT_TAIL(&hist_list, hp, link);
+	table_index_changed(&hist_index);
+	hist_resize(hp);
+	return (hp);
+}
+
+void
+hist_metric_put(struct hist_metric *hp)
+{
+
+	if (hp == NULL)
+		return;
+	if (--hp->refs == 0 && hp->nsamples == 0)
+		hist_free(hp);
+}
+
+void
+hist_add(struct hist_metric *hp, int32_t value)
+{
+	struct hist_sample *sp;
+
+	if (hp == NULL || hp->size == 0)
+		return;
+	hp->last++;
+	sp = &hp->ring[(hp->last - 1) % hp->size];
+	sp->time = (uint32_t)time(NULL);
+	sp->value = value;
+	if (hp->nsamples < hp->size)
+		hp->nsamples++;
+}
+
+/*
+ * Called when histSamples is changed.
+ */
+void
+mibhist_resize(void)
+{
+	struct hist_metric *hp, *tmp;
+
+	TAILQ_FOREACH_SAFE(hp, &hist_list, link, tmp) {
+		if (hist_resize(hp) == -1)
+			continue;
+		if (hp->refs == 0 && hp->nsamples == 0)
+			hist_free(hp);
+	}
+}
+
+/*
+ * Free unreferenced metrics whose samples are all older than the history
+ * period.
+ */
+static void
+hist_expire(void *arg __unused)
+{
+	struct hist_metric *hp, *tmp;
+	uint32_t now, period;
+
+	now = (uint32_t)time(NULL);
+	period = hist_samples * update_interval / 100;
+	TAILQ_FOREACH_SAFE(hp, &hist_list, link, tmp) {
+		if (hp->refs > 0)
+			continue;
+		if (hp->nsamples == 0 ||
+		    now - hp->ring[(hp->last - 1) % hp->size].time > period)
+			hist_free(hp);
+	}
+}
+
+void
+mibhist_init(void)
+{
+
+	register_update_interval_timer(hist_expire);
+}
+
+void
+mibhist_fini(void)
+{
+	struct hist_metric *hp;
+
+	while ((hp = TAILQ_FIRST(&hist_list)) != NULL)
+		hist_free(hp);
+	table_index_free(&hist_index);
+	hist_next_index = 1;
+}
+
+int
+op_histMetricTable(struct snmp_context * context __unused,
+	struct snmp_value * value, u_int sub, u_int iidx __unused,
+	enum snmp_op op)
+{
+	struct hist_metric *hp;
+	asn_subid_t which;
+	int error, ret;
+
+	which = value->var.subs[sub - 1];
+
+	switch (op) {
+	case SNMP_OP_GETNEXT:
+		TABLE_INDEX_UPDATE(&hist_index, &hist_list, hist_metric, error);
+		if (error == 0)
+			hp = table_index_next(&hist_index, &value->var, sub);
+		else
+			hp = NEXT_OBJECT_INT(&hist_list, &value->var, sub);
+		if (hp == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		value->var.len = sub + 1;
+		value->var.subs[sub] = hp->index;
+		break;
+
+	case SNMP_OP_GET:
+		if (value->var.len - sub != 1)
+			return (SNMP_ERR_NOSUCHNAME);
+		if ((hp = find_hist(value->var.subs[sub])) == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		break;
+
+	case SNMP_OP_SET:
+		return (SNMP_ERR_NOT_WRITEABLE);
+
+	case SNMP_OP_ROLLBACK:
+	case SNMP_OP_COMMIT:
+		return (SNMP_ERR_NOERROR);
+
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+
+	ret = SNMP_ERR_NOERROR;
+
+	switch (which) {
+	case LEAF_histMetricIndex:
+		value->v.integer = hp->index;
+		break;
+
+	case LEAF_histMetricName:
+		ret = string_get(value, hp->name, -1);
+		break;
+
+	case LEAF_histMetricSamples:
+		value->v.integer = hp->nsamples;
+		break;
+
+	case LEAF_histMetricLastSample:
+		value->v.integer = hp->last;
+		break;
+
+	default:
+		ret = SNMP_ERR_RES_UNAVAIL;
+		break;
+	}
+
+	return (ret);
+}
+
+/*
+ * Find the sample following the (metric, sample number) index in the oid.
+ */
+static struct hist_metric *
+next_histSample(const struct asn_oid *oid, u_int sub, uint32_t *np)
+{
+	struct hist_metric *hp;
+	asn_subid_t idx, n;
+	int error;
+
+	idx = oid->len - sub > 0 ? oid->subs[sub] : 0;
+	n = oid->len - sub > 1 ? oid->subs[sub + 1] : 0;
+	if (idx > INT32_MAX)
+		return (NULL);		/* No metric follows. */
+
+	/* A following sample of the metric itself. */
+	if (oid->len - sub > 0 && (hp = find_hist(idx)) != NULL &&
+	    hp->nsamples > 0) {
+		if (oid->len - sub == 1 || n < hp->last - hp->nsamples + 1)
+			n = hp->last - hp->nsamples;
+		if (n < hp->last) {
+			*np = n + 1;
+			return (hp);
+		}
+	}
+
+	/* The oldest sample of the next metric having samples. */
+	TABLE_INDEX_UPDATE(&hist_index, &hist_list, hist_metric, error);
+	if (error == 0)
+		hp = table_index_next(&hist_index, oid, sub);
+	else
+		hp = NEXT_OBJECT_INT(&hist_list, oid, sub);
+	while (hp != NULL && hp->nsamples == 0)
+		hp = TAILQ_NEXT(hp, link);
+	if (hp == NULL)
+		return (NULL);
+	*np = hp->last - hp->nsamples + 1;
+	return (hp);
+}
+
+int
+op_histSampleTable(struct snmp_context * context __unused,
+	struct snmp_value * value, u_int sub, u_int iidx __unused,
+	enum snmp_op op)
+{
+	struct hist_metric *hp;
+	struct hist_sample *sp;
+	asn_subid_t which;
+	uint32_t n;
+	int ret;
+
+	which = value->var.subs[sub - 1];
+
+	switch (op) {
+	case SNMP_OP_GETNEXT:
+		hp = next_histSample(&value->var, sub, &n);
+		if (hp == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		value->var.len = sub + 2;
+		value->var.subs[sub] = hp->index;
+		value->var.subs[sub + 1] = n;
+		break;
+
+	case SNMP_OP_GET:
+		if (value->var.len - sub != 2)
+			return (SNMP_ERR_NOSUCHNAME);
+		hp = find_hist(value->var.subs[sub]);
+		if (hp == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		n = value->var.subs[sub + 1];
+		if (n > hp->last || n + hp->nsamples <= hp->last || n == 0)
+			return (SNMP_ERR_NOSUCHNAME);
+		break;
+
+	case SNMP_OP_SET:
+		return (SNMP_ERR_NOT_WRITEABLE);
+
+	case SNMP_OP_ROLLBACK:
+	case SNMP_OP_COMMIT:
+		return (SNMP_ERR_NOERROR);
+
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+
+	sp = &hp->ring[(n - 1) % hp->size];
+	ret = SNMP_ERR_NOERROR;
+
+	switch (which) {
+	case LEAF_histSampleNo:
+		value->v.integer = n;
+		break;
+
+	case LEAF_histSampleTime:
+		value->v.uint32 = sp->time;
+		break;
+
+	case LEAF_histSampleValue:
+		value->v.integer = sp->value;
+		break;
+
+	default:
+		ret = SNMP_ERR_RES_UNAVAIL;
+		break;
+	}
+
+	return (ret);
+}
@@ -48,11 +48,15 @@ struct mibla {
 	int32_t		loadInt;
 	int32_t		errorFlag;
 	u_char		*errMessage;
+	struct hist_metric *_hist;	/* laLoadInt history. */
 };
 
 static struct mibla mibla[3];
 
 static uint64_t last_la_update;	/* Ticks of the last la data update. */
+static int la_loaded;		/* Load averages were read. */
+
+static void sample_la_data(void*);
 
 static const u_char *la_names[] = {
     (const u_char *)"Load-1",
@@ -60,53 +64,76 @@ static const u_char *la_names[] = {
     (const u_char *)"Load-15"
 };
 
+/*
+ * Load averages are read on the first access.
+ */
 void
 mibla_init(void)
 {
-	double sys_la[3];
+	char name[UCDMAXLEN];
 	int i;
 
-	if (getloadavg(sys_la, 3) != 3)
-		syslog(LOG_ERR, "getloadavg failed: %s: %m", __func__);
-
 	for (i=0; i < 3; i++) {
 		mibla[i].index = i + 1;
 		mibla[i].name = la_names[i];
-		snprintf((char *)mibla[i].load, sizeof(mibla[i].load), "%.2f",
-		    sys_la[i]);
 		mibla[i].config = (u_char *)strdup(LACONFIG);
-		mibla[i].loadInt = (int)(100 * sys_la[i]);
 		mibla[i].errorFlag = 0;
 		mibla[i].errMessage = NULL;
+		snprintf(name, sizeof(name), "laLoadInt.%d", i + 1);
+		mibla[i]._hist = hist_metric_get(name);
 	}
-	last_la_update = get_ticks();
+	la_loaded = 0;
+
+	register_update_interval_timer(sample_la_data);
 }
 
 static void
-update_la_data(void)
+read_la_data(void)
 {
 	double sys_la[3];
 	int i;
 
-	/* Update data only once in update_interval. */
-	if ((get_ticks() - last_la_update) > update_interval) {
-		if (getloadavg(sys_la, 3) != 3)
-			syslog(LOG_ERR, "getloadavg failed: %s: %m", __func__);
-
-		for (i = 0; i < 3; i++) {
-			float crit;
-			snprintf ((char *) mibla[i].load, sizeof(mibla[i].load),
-			    "%.2f", sys_la[i]);
-			mibla[i].loadInt = (int) (100 * sys_la[i]);
-			crit = strtof((char *) mibla[i].config, NULL);
-			mibla[i].errorFlag = (crit > 0 && sys_la[i] >= crit);
-		}
-		last_la_update = get_ticks();
+	if (getloadavg(sys_la, 3) != 3)
+		syslog(LOG_ERR, "getloadavg failed: %s: %m", __func__);
+
+	for (i = 0; i < 3; i++) {
+		float crit;
+		snprintf ((char *) mibla[i].load, sizeof(mibla[i].load),
+		    "%.2f", sys_la[i]);
+		mibla[i].loadInt = (int) (100 * sys_la[i]);
+		crit = strtof((char *) mibla[i].config, NULL);
+		mibla[i].errorFlag = (crit > 0 && sys_la[i] >= crit);
 	}
+	last_la_update = get_ticks();
+	la_loaded = 1;
 }
 
-int
-op_laTable(struct snmp_context * context __unused, struct snmp_value * value,
+static void
+update_la_data(void)
+{
+
+	/* Update data only once in update_interval. */
+	if (!la_loaded || (get_ticks() - last_la_update) > update_interval)
+		read_la_data();
+}
+
+/*
+ * Record laLoadInt history every update_interval.
+ */
+static void
+sample_la_data(void *arg __unused)
+{
+	int i;
+
+	if (hist_samples == 0)
+		return;
+	read_la_data();
+	for (i = 0; i < 3; i++)
+		hist_add(mibla[i]._hist, mibla[i].loadInt);
+}
+
+static int
+do_laTable(struct snmp_context * context __unused, struct snmp_value * value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	asn_subid_t which;
@@ -196,3 +223,5 @@ op_laTable(struct snmp_context * context __unused, struct snmp_value * value,
 
 	return (ret);
 };
+
+OPSTAT_HANDLER(laTable, OPSTAT_LATABLE)
@@ -66,7 +66,7 @@ struct mibmemory {
 
 static struct mibmemory mibmem;
 
-static kvm_t *kd;	/* Initialized in init_memory(). */
+static kvm_t *kd;	/* Opened on the first access. */
 
 static int pagesize;	/* Initialized in init_memory(). */
 
@@ -129,6 +129,7 @@ get_mem_data(void)
 }
 
 static uint64_t last_mem_update;	/* Ticks of the last mem data update. */
+static int mem_loaded;			/* Memory data were read. */
 
 /*
  * Init all our memory objects.
@@ -139,33 +140,38 @@ mibmemory_init(void)
 
 	pagesize = getpagesize();
 
-	kd = kvm_open(NULL, _PATH_DEVNULL, NULL, O_RDONLY, "kvm_open");
-	if (kd == NULL)
-		syslog(LOG_ERR, "kvm_open failed: %s: %m", __func__);
-
 	mibmem.index = 0;
 	mibmem.errorName = (const u_char *)"swap";
 	mibmem.minimumSwap = DEFAULTMINIMUMSWAP;
 	mibmem.swapErrorMsg = NULL;
 
-	get_mem_data();
-
-	last_mem_update = get_ticks();
+	mem_loaded = 0;
 }
 
 static void
 update_memory_data(void)
 {
 
+	/*
+	 * kvm_open() and the first vm.vmtotal scan are done on the first
+	 * access, not in mibmemory_init(), to keep bsnmpd startup fast.
+	 */
+	if (!mem_loaded) {
+		kd = kvm_open(NULL, _PATH_DEVNULL, NULL, O_RDONLY, "kvm_open");
+		if (kd == NULL)
+			syslog(LOG_ERR, "kvm_open failed: %s: %m", __func__);
+	}
+
 	/* Update data only once in update_interval. */
-	if (get_ticks() - last_mem_update > update_interval) {
+	if (!mem_loaded || get_ticks() - last_mem_update > update_interval) {
 		get_mem_data();
+		mem_loaded = 1;
 		last_mem_update = get_ticks();
 	}
 }
 
-int
-op_memory(struct snmp_context * context __unused, struct snmp_value * value,
+static int
+do_memory(struct snmp_context * context __unused, struct snmp_value * value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	asn_subid_t which;
@@ -252,3 +258,5 @@ op_memory(struct snmp_context * context __unused, struct snmp_value * value,
 
 	return (ret);
 };
+
+OPSTAT_HANDLER(memory, OPSTAT_MEMORY)
@@ -28,16 +28,17 @@
  */
 
 #include <sys/param.h>
+#include <sys/event.h>
+#include <sys/proc.h>
 #include <sys/queue.h>
 #include <sys/sysctl.h>
+#include <sys/time.h>
 #include <sys/user.h>
-#include <sys/wait.h>
 
 #include <errno.h>
-#include <fcntl.h>
-#include <kvm.h>
+#include <jail.h>
 #include <limits.h>
-#include <paths.h>
+#include <regex.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -50,6 +51,28 @@
  * mibpr structures and functions.
  */
 
+/* prMatch values. */
+#define PR_MATCH_EXACT		1	/* ki_comm is equal to prNames. */
+#define PR_MATCH_PREFIX		2	/* ki_comm starts with prNames. */
+#define PR_MATCH_REGEX		3	/* ki_comm matches prNames regex. */
+#define PR_MATCH_ARGV		4	/* Command line matches prNames regex. */
+
+/* Max length of the command line matched in PR_MATCH_ARGV mode. */
+#define PR_ARGV_MAX		4096
+
+/* Special values of the resolved prJail. */
+#define PR_JID_ANY		-1	/* prJail is not set. */
+#define PR_JID_NONE		-2	/* No such jail is running. */
+
+/* Resource usage of the processes matched by an entry. */
+struct pr_usage {
+	uint64_t		rss;		/* Pages. */
+	uint64_t		pctcpu;		/* Sum of ki_pctcpu. */
+	uint64_t		runtime;	/* Run since the last scan, us. */
+	int32_t			threads;
+	int32_t			files;
+};
+
 struct mibpr {
 	TAILQ_ENTRY(mibpr)	link;
 	int32_t			index;
@@ -59,12 +82,19 @@ struct mibpr {
 	int32_t			max;
 	int32_t			errFix;
 	u_char			*errFixCmd;
-	uint64_t		_fix_ticks;
-};
-
-struct pr_msg {
-	int32_t		result;
-	u_char		output[UCDMAXLEN];
+	struct fix		_fix;
+	int32_t			match;		/* PR_MATCH_*. */
+	u_char			*commFilter;	/* ki_comm for argv match. */
+	struct pr_name		*_name;		/* Counter of the name. */
+	struct mibpr		*_nnext;	/* Next entry of the name. */
+	regex_t			_re;		/* Compiled prNames. */
+	int			_re_ok;		/* _re is valid. */
+	struct pr_usage		usage;
+	int32_t			cpu;		/* 0.01% of one CPU. */
+	int			_hit;		/* Matched the process. */
+	u_char			*jail;		/* JID or name, to match in. */
+	int			_jail_byname;	/* jail is a name. */
+	int			_jid;		/* Resolved jail, PR_JID_*. */
 };
 
 TAILQ_HEAD(mibpr_list, mibpr);
@@ -72,14 +102,119 @@ TAILQ_HEAD(mibpr_list, mibpr);
 static struct mibpr_list mibpr_list = TAILQ_HEAD_INITIALIZER(mibpr_list);
 static uint64_t _ticks;
 
+/*
+ * Hash table of the distinct prNames, so every process costs one lookup.
+ * Entries watching the same name share the counter. Entries that are not
+ * matched by the exact name in any jail are kept in pr_patterns and tried
+ * one by one. Both are rebuilt when prNames change.
+ */
+struct pr_name {
+	struct pr_name		*next;		/* Hash chain. */
+	uint32_t		hash;
+	int32_t			count;
+	struct pr_usage		usage;
+	struct mibpr		*rows;		/* Entries of the name. */
+	char			name[];
+};
+
+static struct pr_name **pr_hash;
+static u_int pr_hash_size;		/* Power of 2. */
+static int pr_hash_dirty = 1;		/* Needs rebuilding. */
+static struct mibpr **pr_patterns;	/* Entries not matched exactly. */
+static u_int pr_npattern;
+static struct mibpr **pr_hits;		/* Entries matching a process. */
+
+/*
+ * Number of processes per jail, counted by the scan, sorted by JID.
+ * JID 0 is the host.
+ */
+struct pr_jail {
+	int32_t			jid;
+	int32_t			count;
+	int32_t			threads;
+	char			name[MAXHOSTNAMELEN];
+};
+
+static struct pr_jail *pr_jails;
+static u_int pr_njails;
+static u_int pr_jails_size;		/* Allocated entries. */
+
+/*
+ * Runtime of the matched processes at the previous and the current scan,
+ * in open addressing hash tables keyed by pid. The CPU usage of an entry is
+ * computed from the runtime deltas between the scans, not from the decayed
+ * ki_pctcpu.
+ */
+struct pr_pid {
+	pid_t			pid;		/* -1 if the slot is free. */
+	struct timeval		start;
+	uint64_t		runtime;	/* us. */
+};
+
+struct pr_pids {
+	struct pr_pid		*slots;
+	u_int			size;		/* Power of 2. */
+};
+
+static struct pr_pids pr_pids[2];
+static struct pr_pids *pr_pids_cur = &pr_pids[0];
+static struct pr_pids *pr_pids_prev = &pr_pids[1];
+static struct timeval pr_scan_time;	/* Time of the previous scan. */
+static uint64_t pr_scan_ticks;		/* 0 if there was no scan. */
+static int pr_pagesize;
+
+/*
+ * Matched processes are watched with kqueue, and prCount is driven by
+ * their events between the full scans: an exit decrements it, children of
+ * watched processes are tracked by the kernel (NOTE_TRACK) and counted for
+ * the same entries as their parent, and a process that calls exec is
+ * matched again. The full scan runs every prScanInterval to reconcile the
+ * counts and find processes started by others. Watches are added for the
+ * processes the scan has found new and deleted for the ones it has not
+ * found, identified by the scan generation.
+ */
+#define PR_TRACK_HASH		256
+
+struct pr_track {
+	LIST_ENTRY(pr_track)	link;
+	pid_t			pid;
+	u_int			gen;		/* Scan that has found it. */
+	int			watched;	/* Added to pr_kq. */
+	u_int			nrows;
+	struct mibpr		*rows[];	/* Entries counting it. */
+};
+
+LIST_HEAD(pr_track_list, pr_track);
+
+static struct pr_track_list pr_tracks[PR_TRACK_HASH];
+static u_int pr_ntracks;
+static u_int pr_scan_gen;
+static uint64_t pr_full_ticks;		/* Last full scan, 0 to force one. */
+static int pr_kq = -1;
+static void *pr_kq_id;
+
+/* Per process data needed by all entries it matches, got once. */
+struct pr_proc {
+	int			done;
+	uint64_t		runtime;
+	int32_t			files;
+};
+
 static void run_prCommands(void*);
 static void run_prFixCmds(void*);
 
+static struct table_index pr_index =
+    TABLE_INDEX_INITIALIZER(struct mibpr, index);
+
 static struct mibpr *
 find_pr(int32_t idx)
 {
 	struct mibpr *prp;
+	int error;
 
+	TABLE_INDEX_UPDATE(&pr_index, &mibpr_list, mibpr, error);
+	if (error == 0)
+		return (table_index_find(&pr_index, idx));
 	TAILQ_FOREACH(prp, &mibpr_list, link) {
 		if (prp->index == idx)
 			return (prp);
@@ -94,186 +229,996 @@ first_mibpr(void)
 	return (TAILQ_FIRST(&mibpr_list));
 }
 
-/*
- * Handle timeouts when executing commands.
- */
 static void
-prcmd_sighandler(int sig __unused)
+reset_counters(int32_t val)
 {
+	struct mibpr *prp;
 
-	_exit(127);
+	TAILQ_FOREACH(prp, &mibpr_list, link) {
+		prp->count = val;
+		memset(&prp->usage, 0, sizeof(prp->usage));
+	}
 }
 
+/* Rescan the process table at the next check. */
 static void
-reset_counters(int32_t val)
+pr_rescan(void)
 {
-	struct mibpr *prp;
 
-	TAILQ_FOREACH(prp, &mibpr_list, link)
-		prp->count = val;
+	_ticks = 0;
+	pr_full_ticks = 0;
+}
+
+/* The constraints of the entry are not satisfied. */
+static int
+pr_failed(const struct mibpr *prp)
+{
+
+	return (prp->count >= 0 &&
+	    ((prp->min != 0 && prp->count < prp->min) ||
+	     (prp->max != 0 && prp->count > prp->max) ||
+	     (prp->min == 0 && prp->max == 0 && prp->count > 0)));
+}
+
+/*
+ * Compile the pattern for the match mode and replace the entry's one.
+ * Returns -1 if the pattern is not a valid regular expression.
+ */
+static int
+pr_compile(struct mibpr *prp, const char *pattern, int32_t match)
+{
+	char errbuf[128];
+	regex_t re;
+	int error;
+
+	if (pattern != NULL &&
+	    (match == PR_MATCH_REGEX || match == PR_MATCH_ARGV)) {
+		error = regcomp(&re, pattern, REG_EXTENDED | REG_NOSUB);
+		if (error != 0) {
+			regerror(error, &re, errbuf, sizeof(errbuf));
+			syslog(LOG_ERR, "invalid pattern `%s': %s: %s",
+			    pattern, errbuf, __func__);
+			return (-1);
+		}
+	}
+	if (prp->_re_ok)
+		regfree(&prp->_re);
+	prp->_re_ok = 0;
+	if (pattern != NULL &&
+	    (match == PR_MATCH_REGEX || match == PR_MATCH_ARGV)) {
+		prp->_re = re;
+		prp->_re_ok = 1;
+	}
+	return (0);
+}
+
+/* FNV-1a. */
+static uint32_t
+pr_name_hash(const char *name)
+{
+	uint32_t h;
+
+	h = 2166136261U;
+	while (*name != '\0') {
+		h ^= (u_char)*name++;
+		h *= 16777619U;
+	}
+	return (h);
+}
+
+static struct pr_name *
+pr_hash_lookup(const char *name, uint32_t h)
+{
+	struct pr_name *np;
+
+	for (np = pr_hash[h & (pr_hash_size - 1)]; np != NULL;
+	    np = np->next) {
+		if (np->hash == h && strcmp(np->name, name) == 0)
+			break;
+	}
+	return (np);
 }
 
 static void
-count_proc(const char *name)
+pr_hash_free(void)
+{
+	struct pr_name *np;
+	u_int i;
+
+	for (i = 0; i < pr_hash_size; i++) {
+		while ((np = pr_hash[i]) != NULL) {
+			pr_hash[i] = np->next;
+			free(np);
+		}
+	}
+	free(pr_hash);
+	pr_hash = NULL;
+	pr_hash_size = 0;
+	free(pr_patterns);
+	pr_patterns = NULL;
+	pr_npattern = 0;
+	free(pr_hits);
+	pr_hits = NULL;
+}
+
+static int
+pr_hash_build(void)
 {
 	struct mibpr *prp;
+	struct pr_name *np;
+	uint32_t h;
+	size_t len;
+	u_int n;
+
+	pr_hash_free();
+
+	n = 0;
+	TAILQ_FOREACH(prp, &mibpr_list, link)
+		n++;
+	for (pr_hash_size = 16; pr_hash_size < 2 * n; pr_hash_size *= 2)
+		;
+	pr_hash = calloc(pr_hash_size, sizeof(*pr_hash));
+	pr_patterns = calloc(n > 0 ? n : 1, sizeof(*pr_patterns));
+	pr_hits = calloc(n > 0 ? n : 1, sizeof(*pr_hits));
+	if (pr_hash == NULL || pr_patterns == NULL || pr_hits == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		if (pr_hash == NULL)
+			pr_hash_size = 0;
+		pr_hash_free();
+		return (-1);
+	}
 
 	TAILQ_FOREACH(prp, &mibpr_list, link) {
+		prp->_name = NULL;
+		prp->_nnext = NULL;
 		if (!prp->names || prp->names[0] == '\0')
 			continue;
-		if (!strcmp((const char *)prp->names, name))
-			prp->count++;
+		if (prp->match != PR_MATCH_EXACT || prp->_jid != PR_JID_ANY) {
+			pr_patterns[pr_npattern++] = prp;
+			continue;
+		}
+		h = pr_name_hash((const char *)prp->names);
+		np = pr_hash_lookup((const char *)prp->names, h);
+		if (np == NULL) {
+			len = strlen((const char *)prp->names) + 1;
+			np = malloc(sizeof(*np) + len);
+			if (np == NULL) {
+				syslog(LOG_ERR, "failed to malloc: %s: %m",
+				    __func__);
+				pr_hash_free();
+				return (-1);
+			}
+			np->hash = h;
+			np->count = 0;
+			np->rows = NULL;
+			memcpy(np->name, prp->names, len);
+			np->next = pr_hash[h & (pr_hash_size - 1)];
+			pr_hash[h & (pr_hash_size - 1)] = np;
+		}
+		prp->_name = np;
+		prp->_nnext = np->rows;
+		np->rows = prp;
 	}
+	pr_hash_dirty = 0;
+	return (0);
+}
+
+static struct pr_pid *
+pr_pid_slot(struct pr_pids *pp, pid_t pid)
+{
+	struct pr_pid *sp;
+	u_int i;
+
+	if (pp->size == 0)
+		return (NULL);
+	for (i = (u_int)pid * 2654435761U; ; i++) {
+		sp = &pp->slots[i & (pp->size - 1)];
+		if (sp->pid == pid || sp->pid == -1)
+			return (sp);
+	}
+}
+
+/*
+ * Prepare the current pid table for the scan of nprocs processes, keeping
+ * the previous one for lookups.
+ */
+static int
+pr_pids_begin(int nprocs)
+{
+	struct pr_pids *pp;
+	struct pr_pid *p;
+	u_int size;
+
+	pp = pr_pids_prev;
+	pr_pids_prev = pr_pids_cur;
+	pr_pids_cur = pp;
+
+	for (size = 64; size < 2 * (u_int)nprocs; size *= 2)
+		;
+	if (pp->size != size) {
+		p = realloc(pp->slots, size * sizeof(*p));
+		if (p == NULL) {
+			syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+			return (-1);
+		}
+		pp->slots = p;
+		pp->size = size;
+	}
+	memset(pp->slots, 0xff, size * sizeof(*pp->slots));
+	return (0);
 }
 
 static void
-get_procs(kvm_t *kd)
+pr_pids_free(void)
 {
-	struct kinfo_proc *kp;
-	int nentries, i;
+	int i;
 
-	nentries = -1;
-	kp = kvm_getprocs(kd, KERN_PROC_PROC, 0, &nentries);
-	if ((kp == NULL && nentries > 0) || (kp != NULL && nentries < 0)) {
-		syslog(LOG_ERR, "failed to kvm_getprocs(): %s: %m", __func__);
-		reset_counters(-1);
-		return;
+	for (i = 0; i < 2; i++) {
+		free(pr_pids[i].slots);
+		pr_pids[i].slots = NULL;
+		pr_pids[i].size = 0;
 	}
-	reset_counters(0);
-	if (nentries > 0) {
-		for (i = nentries; --i >= 0; ++kp)
-			count_proc(kp->ki_comm);
+	pr_scan_ticks = 0;
+}
+
+/*
+ * Get the data of the process needed for accounting: the runtime since
+ * the previous scan and the number of open files.
+ */
+static void
+pr_proc_get(const struct kinfo_proc *kp, struct pr_proc *pp)
+{
+	struct pr_pid *sp;
+#ifdef KERN_PROC_NFDS
+	size_t len;
+	int mib[4], nfds;
+#endif
+
+	pp->done = 1;
+
+	pp->runtime = 0;
+	sp = pr_pid_slot(pr_pids_prev, kp->ki_pid);
+	if (sp != NULL && sp->pid == kp->ki_pid &&
+	    timercmp(&sp->start, &kp->ki_start, ==)) {
+		if (kp->ki_runtime > sp->runtime)
+			pp->runtime = kp->ki_runtime - sp->runtime;
+	} else if (pr_scan_ticks != 0 &&
+	    timercmp(&kp->ki_start, &pr_scan_time, >)) {
+		/* Started after the previous scan. */
+		pp->runtime = kp->ki_runtime;
 	}
+	sp = pr_pid_slot(pr_pids_cur, kp->ki_pid);
+	if (sp != NULL) {
+		sp->pid = kp->ki_pid;
+		sp->start = kp->ki_start;
+		sp->runtime = kp->ki_runtime;
+	}
+
+	/* kern.proc.nfds is not available before FreeBSD 13. */
+	pp->files = 0;
+#ifdef KERN_PROC_NFDS
+	mib[0] = CTL_KERN;
+	mib[1] = KERN_PROC;
+	mib[2] = KERN_PROC_NFDS;
+	mib[3] = kp->ki_pid;
+	len = sizeof(nfds);
+	if (sysctl(mib, 4, &nfds, &len, NULL, 0) == 0)
+		pp->files = nfds;
+#endif
+}
+
+static void
+pr_account(struct pr_usage *up, const struct kinfo_proc *kp,
+    struct pr_proc *pp)
+{
+
+	if (!pp->done)
+		pr_proc_get(kp, pp);
+	up->rss += kp->ki_rssize;
+	up->pctcpu += kp->ki_pctcpu;
+	up->runtime += pp->runtime;
+	up->threads += kp->ki_numthreads;
+	up->files += pp->files;
 }
 
 /*
- * Count processes.
+ * Match the process against entries that are not matched via the hash,
+ * setting _hit of the matched ones. Returns the number of matches.
+ * The command line is fetched only for processes whose command name is
+ * the prCommFilter of some entry, and at most once.
  */
-void
-run_prCommands(void* arg __unused)
+static int
+pr_match(const struct kinfo_proc *kp)
 {
-	char errbuf[_POSIX2_LINE_MAX];
-	kvm_t *kd;
-	uint64_t current;
+	static char args[PR_ARGV_MAX];
+	struct mibpr *prp;
+	int argv_state;		/* 0 - not fetched, 1 - fetched, -1 - failed. */
+	int matched, nhits;
+	u_int i;
+
+	argv_state = 0;
+	nhits = 0;
+	for (i = 0; i < pr_npattern; i++) {
+		prp = pr_patterns[i];
+		if (prp->_jid != PR_JID_ANY && prp->_jid != kp->ki_jid)
+			continue;
+		matched = 0;
+		switch (prp->match) {
+		case PR_MATCH_EXACT:
+			/* Entries limited to a jail are not in the hash. */
+			matched = prp->_name == NULL && strcmp(kp->ki_comm,
+			    (const char *)prp->names) == 0;
+			break;
 
-	current = get_ticks();
+		case PR_MATCH_PREFIX:
+			matched = strncmp(kp->ki_comm,
+			    (const char *)prp->names,
+			    strlen((const char *)prp->names)) == 0;
+			break;
 
-	 /* Run counting only if ext_update_interval exceeded. */
-	if ((current - _ticks) < ext_update_interval)
-		return;
+		case PR_MATCH_REGEX:
+			matched = prp->_re_ok &&
+			    regexec(&prp->_re, kp->ki_comm, 0, NULL, 0) == 0;
+			break;
 
-	kd = kvm_openfiles(_PATH_DEVNULL, _PATH_DEVNULL, NULL, O_RDONLY, errbuf);
-	if (kd == 0) {
-		syslog(LOG_ERR, "failed to kvm_openfiles(): %s: %m", __func__);
-		return;
+		case PR_MATCH_ARGV:
+			/* prCommFilter is required in this mode. */
+			if (!prp->_re_ok || (kp->ki_flag & P_SYSTEM) != 0 ||
+			    prp->commFilter == NULL ||
+			    strcmp(kp->ki_comm,
+			    (const char *)prp->commFilter) != 0)
+				break;
+			if (argv_state == 0) {
+				argv_state = procsnap_getargs(kp->ki_pid,
+				    args, sizeof(args)) == 0 ? 1 : -1;
+			}
+			matched = argv_state == 1 &&
+			    regexec(&prp->_re, args, 0, NULL, 0) == 0;
+			break;
+
+		default:
+			break;
+		}
+		if (matched) {
+			prp->_hit = 1;
+			nhits++;
+		}
 	}
-	get_procs(kd);
-	if (kvm_close(kd) == -1)
-		syslog(LOG_ERR, "failed to kvm_close(): %s: %m", __func__);
+	return (nhits);
+}
 
-	_ticks = get_ticks();
+static struct pr_track *
+pr_track_find(pid_t pid)
+{
+	struct pr_track *tp;
+
+	LIST_FOREACH(tp, &pr_tracks[pid % PR_TRACK_HASH], link) {
+		if (tp->pid == pid)
+			break;
+	}
+	return (tp);
+}
+
+static void
+pr_track_add(struct pr_track *tp)
+{
+
+	LIST_INSERT_HEAD(&pr_tracks[tp->pid % PR_TRACK_HASH], tp, link);
+	pr_ntracks++;
+}
+
+static void
+pr_track_del(struct pr_track *tp)
+{
+
+	LIST_REMOVE(tp, link);
+	pr_ntracks--;
+	free(tp);
 }
 
 /*
- * Run fix commands.
+ * Collect in pr_hits the entries with the name np and the entries with
+ * _hit set, clearing _hit. Returns the number of entries.
  */
-void
-run_prFixCmds(void* arg __unused)
+static u_int
+pr_track_hits(const struct pr_name *np)
 {
 	struct mibpr *prp;
-	uint64_t current;
-	pid_t pid, res;
-	int status, fd;
+	u_int i, n;
 
-	current = get_ticks();
+	n = 0;
+	if (np != NULL) {
+		for (prp = np->rows; prp != NULL; prp = prp->_nnext)
+			pr_hits[n++] = prp;
+	}
+	for (i = 0; i < pr_npattern; i++) {
+		prp = pr_patterns[i];
+		if (prp->_hit) {
+			pr_hits[n++] = prp;
+			prp->_hit = 0;
+		}
+	}
+	return (n);
+}
 
-	/* Run commads if needed. */
+/*
+ * Track the process for the n entries in pr_hits, keeping the existing
+ * track if it is for the same entries. Returns NULL on failure.
+ */
+static struct pr_track *
+pr_track_set(pid_t pid, u_int n)
+{
+	struct pr_track *tp, *otp;
 
-	TAILQ_FOREACH(prp, &mibpr_list, link) {
+	otp = pr_track_find(pid);
+	if (otp != NULL && otp->nrows == n &&
+	    memcmp(otp->rows, pr_hits, n * sizeof(otp->rows[0])) == 0) {
+		otp->gen = pr_scan_gen;
+		return (otp);
+	}
+	tp = malloc(sizeof(*tp) + n * sizeof(tp->rows[0]));
+	if (tp == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (NULL);
+	}
+	tp->pid = pid;
+	tp->gen = pr_scan_gen;
+	tp->watched = 0;
+	tp->nrows = n;
+	memcpy(tp->rows, pr_hits, n * sizeof(tp->rows[0]));
+	if (otp != NULL) {
+		tp->watched = otp->watched;
+		pr_track_del(otp);
+	}
+	pr_track_add(tp);
+	return (tp);
+}
+
+static struct pr_track *
+pr_track_copy(pid_t pid, const struct pr_track *src)
+{
+	struct pr_track *tp;
 
-		if (!prp->errFix)
-			continue; /* No fix. */
+	tp = malloc(sizeof(*tp) + src->nrows * sizeof(tp->rows[0]));
+	if (tp == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (NULL);
+	}
+	tp->pid = pid;
+	tp->gen = src->gen;
+	tp->watched = 1;	/* By the kernel, NOTE_TRACK. */
+	tp->nrows = src->nrows;
+	memcpy(tp->rows, src->rows, src->nrows * sizeof(tp->rows[0]));
+	pr_track_add(tp);
+	return (tp);
+}
 
-		if (!prp->errFixCmd)
-			continue; /* No command specified. */
+/* Add delta (1 or -1) to prCount of the entries counting the process. */
+static void
+pr_track_count(const struct pr_track *tp, int delta)
+{
+	struct mibpr *prp;
+	u_int i;
 
-		if ((current - prp->_fix_ticks) < ext_update_interval)
-			continue; /* ext_update_interval has not exceeded. */
+	for (i = 0; i < tp->nrows; i++) {
+		prp = tp->rows[i];
+		if (prp->count < 0 || prp->count + delta < 0)
+			continue;	/* Counting failed. */
+		prp->count += delta;
+	}
+}
 
-		if (prp->count < 0 ||
-		    ((prp->min == 0 || prp->count >= prp->min) &&
-		     (prp->max == 0 || prp->count <= prp->max) &&
-		     (prp->min != 0 || prp->max != 0 || prp->count <= 0)))
-			continue; /* All constraints are satisfied */
+static int
+pr_track_watch(pid_t pid, int add)
+{
+	struct kevent ev;
 
-		/* Execute the command in the child process. */
-		pid = fork();
+	EV_SET(&ev, pid, EVFILT_PROC, add ? EV_ADD : EV_DELETE,
+	    NOTE_EXIT | NOTE_EXEC | NOTE_TRACK, 0, NULL);
+	return (kevent(pr_kq, &ev, 1, NULL, 0, NULL));
+}
 
-		if (pid == 0) {
-			/* Close all descriptors except stdio. */
-			for (fd = 3; fd <= getdtablesize(); fd++)
-				close(fd);
+/*
+ * The process has called exec: match it again.
+ */
+static void
+pr_track_exec(pid_t pid)
+{
+	struct kinfo_proc kp;
+	struct pr_track *tp;
+	struct pr_name *np;
+	u_int n;
+
+	tp = pr_track_find(pid);
+	if (tp != NULL)
+		pr_track_count(tp, -1);
+	n = 0;
+	if (!pr_hash_dirty && procsnap_getpid(pid, &kp) == 0) {
+		np = pr_hash_lookup(kp.ki_comm, pr_name_hash(kp.ki_comm));
+		if (pr_npattern > 0)
+			pr_match(&kp);
+		n = pr_track_hits(np);
+	}
+	tp = n > 0 ? pr_track_set(pid, n) : NULL;
+	if (tp != NULL) {
+		tp->watched = 1;
+		pr_track_count(tp, 1);
+		return;
+	}
+	tp = pr_track_find(pid);
+	if (tp != NULL)
+		pr_track_del(tp);
+	pr_track_watch(pid, 0);
+}
 
-			/* Fork again. */
-			if ((pid = fork()) < 0) {
-				syslog(LOG_ERR, "Can't fork: %s: %m", __func__);
-				_exit(127);
+/*
+ * kqueue is readable: events of the watched processes.
+ */
+static void
+pr_kq_read(int fd __unused, void *arg __unused)
+{
+	static const struct timespec zero = { 0, 0 };
+	struct kevent ev[16];
+	struct pr_track *tp, *parent;
+	pid_t pid;
+	int i, n;
+
+	do {
+		n = kevent(pr_kq, NULL, 0, ev, sizeof(ev) / sizeof(ev[0]),
+		    &zero);
+		if (n == -1 && errno != EINTR)
+			syslog(LOG_ERR, "kevent failed: %s: %m", __func__);
+
+		for (i = 0; i < n; i++) {
+			if (ev[i].filter != EVFILT_PROC ||
+			    (ev[i].flags & EV_ERROR) != 0)
+				continue;
+			pid = ev[i].ident;
+			if ((ev[i].fflags & NOTE_TRACKERR) != 0) {
+				/* A child is not tracked. */
+				pr_rescan();
+			}
+			if ((ev[i].fflags & NOTE_CHILD) != 0 &&
+			    pr_track_find(pid) == NULL) {
+				parent = pr_track_find(ev[i].data);
+				tp = parent != NULL ?
+				    pr_track_copy(pid, parent) : NULL;
+				if (tp != NULL)
+					pr_track_count(tp, 1);
+				else
+					pr_track_watch(pid, 0);
 			}
+			if ((ev[i].fflags & NOTE_EXIT) != 0) {
+				tp = pr_track_find(pid);
+				if (tp != NULL) {
+					pr_track_count(tp, -1);
+					pr_track_del(tp);
+				}
+				continue;
+			}
+			if ((ev[i].fflags & NOTE_EXEC) != 0)
+				pr_track_exec(pid);
+		}
+	} while (n == sizeof(ev) / sizeof(ev[0]));
+}
 
-			if (pid == 0) { /* Grandchild. */
-				/* Become process group leader. */
-				setpgid(0, 0);
+static void
+pr_track_init(void)
+{
 
-				/* Trap commands that timed out. */
-				signal(SIGALRM, prcmd_sighandler);
-				alarm(ext_timeout);
+	pr_kq = kqueue();
+	if (pr_kq == -1) {
+		syslog(LOG_ERR, "kqueue failed: %s: %m", __func__);
+		return;
+	}
+	pr_kq_id = fd_select(pr_kq, pr_kq_read, NULL, ucd_module);
+	if (pr_kq_id == NULL) {
+		syslog(LOG_ERR, "fd_select failed: %s: %m", __func__);
+		close(pr_kq);
+		pr_kq = -1;
+	}
+}
 
-				/* Run the command. */
-				status = system((char*)prp->errFixCmd);
-				if (status != 0) {
-					syslog(LOG_WARNING,
-					    "command `%s' has retuned status %d",
-					    prp->errFixCmd, WEXITSTATUS(status));
-				}
-				_exit(WEXITSTATUS(status));
+static void
+pr_track_fini(void)
+{
+	struct pr_track *tp;
+	int i;
+
+	for (i = 0; i < PR_TRACK_HASH; i++) {
+		while ((tp = LIST_FIRST(&pr_tracks[i])) != NULL)
+			pr_track_del(tp);
+	}
+	if (pr_kq_id != NULL)
+		fd_deselect(pr_kq_id);
+	pr_kq_id = NULL;
+	if (pr_kq != -1)
+		close(pr_kq);
+	pr_kq = -1;
+	pr_full_ticks = 0;
+}
+
+/*
+ * Bring the watches in line with the scan: processes that are not matched
+ * any more are dropped and the new ones are watched. A process that has
+ * exited since the scan is not counted any more.
+ */
+static void
+pr_track_sync(void)
+{
+	struct pr_track *tp, *tmp;
+	int i;
+
+	for (i = 0; i < PR_TRACK_HASH; i++) {
+		LIST_FOREACH_SAFE(tp, &pr_tracks[i], link, tmp) {
+			if (tp->gen != pr_scan_gen) {
+				if (tp->watched)
+					pr_track_watch(tp->pid, 0);
+				pr_track_del(tp);
+				continue;
+			}
+			if (tp->watched)
+				continue;
+			if (pr_track_watch(tp->pid, 1) == 0) {
+				tp->watched = 1;
+				continue;
+			}
+			if (errno == ESRCH)
+				pr_track_count(tp, -1);
+			pr_track_del(tp);
+		}
+	}
+}
+
+
+/*
+ * Parse prJail: empty means any jail, a number is a JID (0 is the host),
+ * anything else is a jail name resolved at every scan, as the JID changes
+ * when the jail is restarted.
+ */
+static void
+pr_jail_parse(struct mibpr *prp)
+{
+	const char *p;
+	char *ep;
+	long jid;
+
+	prp->_jail_byname = 0;
+	p = (const char *)prp->jail;
+	if (p == NULL || *p == '\0') {
+		prp->_jid = PR_JID_ANY;
+		return;
+	}
+	jid = strtol(p, &ep, 10);
+	if (*ep == '\0' && jid >= 0 && jid <= INT_MAX) {
+		prp->_jid = jid;
+		return;
+	}
+	prp->_jail_byname = 1;
+	prp->_jid = PR_JID_NONE;
+}
+
+static void
+pr_jail_resolve(void)
+{
+	struct mibpr *prp;
+	int jid;
+
+	TAILQ_FOREACH(prp, &mibpr_list, link) {
+		if (!prp->_jail_byname)
+			continue;
+		jid = jail_getid((const char *)prp->jail);
+		prp->_jid = jid >= 0 ? jid : PR_JID_NONE;
+	}
+}
+
+/*
+ * Count the process in the per jail summary.
+ */
+static void
+pr_jail_count(const struct kinfo_proc *kp)
+{
+	struct pr_jail *jp;
+	u_int lo, hi, mid;
+
+	lo = 0;
+	hi = pr_njails;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (pr_jails[mid].jid < kp->ki_jid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == pr_njails || pr_jails[lo].jid != kp->ki_jid) {
+		if (pr_njails == pr_jails_size) {
+			jp = realloc(pr_jails, (pr_jails_size + 16) *
+			    sizeof(*jp));
+			if (jp == NULL) {
+				syslog(LOG_ERR, "failed to malloc: %s: %m",
+				    __func__);
+				return;
 			}
+			pr_jails = jp;
+			pr_jails_size += 16;
+		}
+		memmove(&pr_jails[lo + 1], &pr_jails[lo],
+		    (pr_njails - lo) * sizeof(*pr_jails));
+		pr_njails++;
+		memset(&pr_jails[lo], 0, sizeof(*pr_jails));
+		pr_jails[lo].jid = kp->ki_jid;
+	}
+	pr_jails[lo].count++;
+	pr_jails[lo].threads += kp->ki_numthreads;
+}
+
+static void
+pr_jail_names(void)
+{
+	char *name;
+	u_int i;
 
-			/* Parent of grandchild. */
-			_exit(0);
+	for (i = 0; i < pr_njails; i++) {
+		if (pr_jails[i].jid == 0)
+			continue;
+		name = jail_getname(pr_jails[i].jid);
+		if (name != NULL) {
+			strlcpy(pr_jails[i].name, name,
+			    sizeof(pr_jails[i].name));
+			free(name);
 		}
+	}
+}
+
+static struct pr_jail *
+find_pr_jail(asn_subid_t jid)
+{
+	u_int i;
+
+	for (i = 0; i < pr_njails; i++) {
+		if ((asn_subid_t)pr_jails[i].jid == jid)
+			return (&pr_jails[i]);
+	}
+	return (NULL);
+}
+
+static struct pr_jail *
+next_pr_jail(const struct asn_oid *oid, u_int sub)
+{
+	u_int i;
 
-		/* Parent. */
+	if (oid->len - sub == 0)
+		return (pr_njails > 0 ? &pr_jails[0] : NULL);
+	for (i = 0; i < pr_njails; i++) {
+		if ((asn_subid_t)pr_jails[i].jid > oid->subs[sub])
+			return (&pr_jails[i]);
+	}
+	return (NULL);
+}
 
-		if (pid == -1)
-			syslog(LOG_ERR, "Can't fork: %s: %m", __func__);
+/*
+ * Compute the CPU usage of the entries from the runtime accounted since
+ * the previous scan.
+ */
+static void
+pr_usage_done(uint64_t ticks, const struct timeval *now)
+{
+	struct mibpr *prp;
+	uint64_t elapsed;
+
+	elapsed = pr_scan_ticks != 0 ? ticks - pr_scan_ticks : 0;
+	TAILQ_FOREACH(prp, &mibpr_list, link) {
+		/* runtime is in us and elapsed in 0.01 s, so it is 0.01%. */
+		prp->cpu = elapsed > 0 ?
+		    MIN(prp->usage.runtime / elapsed, INT32_MAX) : 0;
+	}
+	pr_scan_ticks = ticks;
+	pr_scan_time = *now;
+}
+
+/*
+ * Update the resource usage of the entries from the tracked processes
+ * only, between the full scans.
+ */
+static void
+pr_track_usage(void)
+{
+	struct kinfo_proc kp;
+	struct pr_track *tp, *tmp;
+	struct mibpr *prp;
+	struct pr_proc proc;
+	struct timeval now;
+	uint64_t ticks;
+	u_int j;
+	int i;
+
+	if (pr_pids_begin((int)pr_ntracks) == -1) {
+		pr_scan_ticks = 0;
+		return;
+	}
+	ticks = get_ticks();
+	gettimeofday(&now, NULL);
 
-		/* Wait for child. */
-		for (;;) {
-			res = waitpid(pid, &status, 0);
-			if (res == -1 && errno == EINTR)
+	TAILQ_FOREACH(prp, &mibpr_list, link)
+		memset(&prp->usage, 0, sizeof(prp->usage));
+	for (i = 0; i < PR_TRACK_HASH; i++) {
+		LIST_FOREACH_SAFE(tp, &pr_tracks[i], link, tmp) {
+			if (procsnap_getpid(tp->pid, &kp) == -1) {
+				if (errno == ESRCH) {
+					/* The exit event is not read yet. */
+					pr_track_count(tp, -1);
+					pr_track_del(tp);
+				}
 				continue;
-			if (res == -1)
-				syslog(LOG_ERR, "failed to waitpid: %s: %m", __func__);
-			break;
+			}
+			proc.done = 0;
+			for (j = 0; j < tp->nrows; j++)
+				pr_account(&tp->rows[j]->usage, &kp, &proc);
 		}
-		prp->_fix_ticks = get_ticks();
 	}
+	pr_usage_done(ticks, &now);
 }
 
-int
-op_prTable(struct snmp_context * context __unused, struct snmp_value * value,
+static void
+get_procs(void)
+{
+	struct kinfo_proc *kp;
+	struct mibpr *prp;
+	struct pr_name *np;
+	struct pr_proc proc;
+	struct timeval now;
+	uint64_t ticks;
+	int nentries, i, nhits;
+	u_int j;
+
+	if (pr_hash_dirty && pr_hash_build() == -1) {
+		reset_counters(-1);
+		return;
+	}
+
+	/* Events that happened before the snapshot are reflected in it. */
+	if (pr_kq != -1)
+		pr_kq_read(pr_kq, NULL);
+
+	nentries = procsnap_get(&kp);
+	if (nentries == -1) {
+		reset_counters(-1);
+		pr_njails = 0;
+		return;
+	}
+	if (pr_pids_begin(nentries) == -1) {
+		reset_counters(-1);
+		pr_scan_ticks = 0;
+		return;
+	}
+	ticks = get_ticks();
+	gettimeofday(&now, NULL);
+
+	for (j = 0; j < pr_hash_size; j++) {
+		for (np = pr_hash[j]; np != NULL; np = np->next) {
+			np->count = 0;
+			memset(&np->usage, 0, sizeof(np->usage));
+		}
+	}
+	reset_counters(0);
+	pr_scan_gen++;
+	pr_jail_resolve();
+	pr_njails = 0;
+	for (i = nentries; --i >= 0; ++kp) {
+		pr_jail_count(kp);
+		proc.done = 0;
+		np = pr_hash_lookup(kp->ki_comm, pr_name_hash(kp->ki_comm));
+		if (np != NULL) {
+			np->count++;
+			pr_account(&np->usage, kp, &proc);
+		}
+		nhits = pr_npattern > 0 ? pr_match(kp) : 0;
+		if (nhits > 0) {
+			for (j = 0; j < pr_npattern; j++) {
+				prp = pr_patterns[j];
+				if (!prp->_hit)
+					continue;
+				prp->count++;
+				pr_account(&prp->usage, kp, &proc);
+				if (pr_kq == -1)
+					prp->_hit = 0;
+			}
+		}
+		if (pr_kq != -1 && (np != NULL || nhits > 0))
+			pr_track_set(kp->ki_pid, pr_track_hits(np));
+	}
+
+	TAILQ_FOREACH(prp, &mibpr_list, link) {
+		if (prp->_name != NULL) {
+			prp->count = prp->_name->count;
+			prp->usage = prp->_name->usage;
+		}
+	}
+	pr_usage_done(ticks, &now);
+	pr_jail_names();
+
+	if (pr_kq != -1)
+		pr_track_sync();
+	pr_full_ticks = ticks;
+}
+
+/*
+ * The full scan is due: prScanInterval has passed, kqueue is not available
+ * or some entry is in error, so that a restarted process is noticed at the
+ * next extUpdateInterval.
+ */
+static int
+pr_scan_due(uint64_t current)
+{
+	struct mibpr *prp;
+
+	if (pr_kq == -1 || pr_full_ticks == 0 ||
+	    (current - pr_full_ticks) >= pr_scan_interval)
+		return (1);
+	TAILQ_FOREACH(prp, &mibpr_list, link) {
+		if (prp->count < 0 || pr_failed(prp))
+			return (1);
+	}
+	return (0);
+}
+
+/*
+ * Count processes.
+ */
+void
+run_prCommands(void* arg __unused)
+{
+	uint64_t current;
+
+	current = get_ticks();
+
+	 /* Run counting only if ext_update_interval exceeded. */
+	if ((current - _ticks) < ext_update_interval)
+		return;
+
+	if (pr_scan_due(current))
+		get_procs();
+	else
+		pr_track_usage();
+
+	_ticks = get_ticks();
+}
+
+/*
+ * Request fixes of entries whose constraints are not satisfied.
+ */
+void
+run_prFixCmds(void* arg __unused)
+{
+	struct mibpr *prp;
+
+	TAILQ_FOREACH(prp, &mibpr_list, link) {
+		if (!prp->errFix || !prp->errFixCmd || !pr_failed(prp))
+			fix_reset(&prp->_fix); /* Nothing to fix. */
+		else
+			fix_request(&prp->_fix, prp->errFixCmd);
+	}
+}
+
+static int
+do_prTable(struct snmp_context * context __unused, struct snmp_value * value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	struct mibpr *prp;
 	asn_subid_t which;
 	u_char buf[UCDMAXLEN];
-	int ret;
+	char *pattern;
+	int error, ret;
 
 	which = value->var.subs[sub - 1];
 
 	switch (op) {
 	case SNMP_OP_GETNEXT:
-		prp = NEXT_OBJECT_INT(&mibpr_list, &value->var, sub);
+		TABLE_INDEX_UPDATE(&pr_index, &mibpr_list, mibpr, error);
+		if (error == 0)
+			prp = table_index_next(&pr_index, &value->var, sub);
+		else
+			prp = NEXT_OBJECT_INT(&mibpr_list, &value->var, sub);
 		if (prp == NULL)
 			return (SNMP_ERR_NOSUCHNAME);
 		value->var.len = sub + 1;
@@ -302,9 +1247,73 @@ op_prTable(struct snmp_context * context __unused, struct snmp_value * value,
 				}
 				memset(prp, 0, sizeof(*prp));
 				prp->index = value->var.subs[sub];
+				prp->match = PR_MATCH_EXACT;
+				prp->_jid = PR_JID_ANY;
+				fix_init(&prp->_fix);
 				INSERT_OBJECT_INT(prp, &mibpr_list);
+				table_index_changed(&pr_index);
 			}
+			pattern = malloc(value->v.octetstring.len + 1);
+			if (pattern == NULL) {
+				syslog(LOG_ERR, "failed to malloc: %s: %m",
+				    __func__);
+				return (SNMP_ERR_RES_UNAVAIL);
+			}
+			memcpy(pattern, value->v.octetstring.octets,
+			    value->v.octetstring.len);
+			pattern[value->v.octetstring.len] = '\0';
+			ret = pr_compile(prp, pattern, prp->match);
+			free(pattern);
+			if (ret == -1)
+				return (SNMP_ERR_WRONG_VALUE);
 			ret = string_save(value, context, -1, &prp->names);
+			pr_hash_dirty = 1;
+			pr_rescan();
+			return (ret);
+
+		case LEAF_prMatch:
+			prp = find_pr(value->var.subs[sub]);
+			if (prp == NULL)
+				return (SNMP_ERR_NOT_WRITEABLE);
+			if (value->v.integer < PR_MATCH_EXACT ||
+			    value->v.integer > PR_MATCH_ARGV)
+				return (SNMP_ERR_WRONG_VALUE);
+			/*
+			 * Reading the command line of every process is too
+			 * expensive, prCommFilter has to be set first.
+			 */
+			if (value->v.integer == PR_MATCH_ARGV &&
+			    (prp->commFilter == NULL ||
+			    prp->commFilter[0] == '\0'))
+				return (SNMP_ERR_WRONG_VALUE);
+			if (pr_compile(prp, (const char *)prp->names,
+			    value->v.integer) == -1)
+				return (SNMP_ERR_WRONG_VALUE);
+			prp->match = value->v.integer;
+			pr_hash_dirty = 1;
+			pr_rescan();
+			return SNMP_ERR_NOERROR;
+
+		case LEAF_prCommFilter:
+			prp = find_pr(value->var.subs[sub]);
+			if (prp == NULL)
+				return (SNMP_ERR_NOT_WRITEABLE);
+			if (prp->match == PR_MATCH_ARGV &&
+			    value->v.octetstring.len == 0)
+				return (SNMP_ERR_WRONG_VALUE);
+			ret = string_save(value, context, -1, &prp->commFilter);
+			return (ret);
+
+		case LEAF_prJail:
+			prp = find_pr(value->var.subs[sub]);
+			if (prp == NULL)
+				return (SNMP_ERR_NOT_WRITEABLE);
+			ret = string_save(value, context, -1, &prp->jail);
+			if (ret != SNMP_ERR_NOERROR)
+				return (ret);
+			pr_jail_parse(prp);
+			pr_hash_dirty = 1;
+			pr_rescan();
 			return (ret);
 
 		case LEAF_prMin:
@@ -372,14 +1381,7 @@ op_prTable(struct snmp_context * context __unused, struct snmp_value * value,
 		break;
 
 	case LEAF_prErrorFlag:
-		if (prp->count >= 0 &&
-		    ((prp->min != 0 && prp->count < prp->min) ||
-		     (prp->max != 0 && prp->count > prp->max) ||
-		     (prp->min == 0 && prp->max == 0 && prp->count > 0))) {
-			value->v.integer = 1;
-		} else {
-			value->v.integer = 0;
-		}
+		value->v.integer = pr_failed(prp);
 		break;
 
 	case LEAF_prErrMessage:
@@ -410,6 +1412,54 @@ op_prTable(struct snmp_context * context __unused, struct snmp_value * value,
 		ret = string_get(value, prp->errFixCmd, -1);
 		break;
 
+	case LEAF_prMatch:
+		value->v.integer = prp->match;
+		break;
+
+	case LEAF_prJail:
+		ret = string_get(value, prp->jail, -1);
+		break;
+
+	case LEAF_prRSS:
+		value->v.integer = MIN(prp->usage.rss * (pr_pagesize >> 10),
+		    INT32_MAX);
+		break;
+
+	case LEAF_prPctCpu:
+		value->v.integer = MIN(prp->usage.pctcpu * 10000 / FSCALE,
+		    INT32_MAX);
+		break;
+
+	case LEAF_prCPU:
+		value->v.integer = prp->cpu;
+		break;
+
+	case LEAF_prThreads:
+		value->v.integer = prp->usage.threads;
+		break;
+
+	case LEAF_prOpenFiles:
+		value->v.integer = prp->usage.files;
+		break;
+
+	case LEAF_prCommFilter:
+		ret = string_get(value, prp->commFilter, -1);
+		break;
+
+	case LEAF_prFixRuns:
+	case LEAF_prFixTimeouts:
+	case LEAF_prFixSpawnFailures:
+	case LEAF_prFixLastRuntime:
+	case LEAF_prFixAvgRuntime:
+	case LEAF_prFixMaxRuntime:
+	case LEAF_prFixUserTime:
+	case LEAF_prFixSystemTime:
+	case LEAF_prFixLastStart:
+	case LEAF_prFixLastEnd:
+		ret = spawn_stats_get(&prp->_fix.stats, which - LEAF_prFixRuns,
+		    value);
+		break;
+
 	default:
 		ret = SNMP_ERR_RES_UNAVAIL;
 		break;
@@ -418,6 +1468,8 @@ op_prTable(struct snmp_context * context __unused, struct snmp_value * value,
 	return (ret);
 };
 
+OPSTAT_HANDLER(prTable, OPSTAT_PRTABLE)
+
 /*
  * mibpr initialization.
  */
@@ -425,6 +1477,9 @@ void
 mibpr_init(void)
 {
 
+	pr_pagesize = getpagesize();
+	pr_track_init();
+
 	register_ext_check_interval_timer(run_prCommands);
 	register_ext_check_interval_timer(run_prFixCmds);
 }
@@ -439,7 +1494,13 @@ mibpr_free(void)
 
 	while ((prp = first_mibpr()) != NULL) {
 		TAILQ_REMOVE (&mibpr_list, prp, link);
+		table_index_changed(&pr_index);
+		fix_cancel(&prp->_fix);
+		if (prp->_re_ok)
+			regfree(&prp->_re);
 		free(prp->names);
+		free(prp->commFilter);
+		free(prp->jail);
 		free(prp->errFixCmd);
 		free (prp);
 	}
@@ -450,4 +1511,79 @@ mibpr_fini(void)
 {
 
 	mibpr_free();
+	table_index_free(&pr_index);
+	pr_hash_free();
+	pr_hash_dirty = 1;
+	pr_pids_free();
+	pr_track_fini();
+	free(pr_jails);
+	pr_jails = NULL;
+	pr_njails = 0;
+	pr_jails_size = 0;
+}
+
+int
+op_prJailTable(struct snmp_context * context __unused,
+	struct snmp_value * value, u_int sub, u_int iidx __unused,
+	enum snmp_op op)
+{
+	struct pr_jail *jp;
+	asn_subid_t which;
+	int ret;
+
+	which = value->var.subs[sub - 1];
+
+	switch (op) {
+	case SNMP_OP_GETNEXT:
+		jp = next_pr_jail(&value->var, sub);
+		if (jp == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		value->var.len = sub + 1;
+		value->var.subs[sub] = jp->jid;
+		break;
+
+	case SNMP_OP_GET:
+		if (value->var.len - sub != 1)
+			return (SNMP_ERR_NOSUCHNAME);
+		jp = find_pr_jail(value->var.subs[sub]);
+		if (jp == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		break;
+
+	case SNMP_OP_SET:
+		return (SNMP_ERR_NOT_WRITEABLE);
+
+	case SNMP_OP_ROLLBACK:
+	case SNMP_OP_COMMIT:
+		return (SNMP_ERR_NOERROR);
+
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+
+	ret = SNMP_ERR_NOERROR;
+
+	switch (which) {
+	case LEAF_prJailIndex:
+		value->v.integer = jp->jid;
+		break;
+
+	case LEAF_prJailName:
+		ret = string_get(value, (u_char *)jp->name, -1);
+		break;
+
+	case LEAF_prJailProcesses:
+		value->v.integer = jp->count;
+		break;
+
+	case LEAF_prJailThreads:
+		value->v.integer = jp->threads;
+		break;
+
+	default:
+		ret = SNMP_ERR_RES_UNAVAIL;
+		break;
+	}
+
+	return (ret);
 }
@@ -74,9 +74,14 @@ static struct mibss mibss;
 
 static int pagesize;	/* Initialized in mibss_init(). */
 
+static int ss_loaded;	/* The first sample was taken. */
+
+static struct hist_metric *ss_idle_hist;	/* ssCpuIdle history. */
+
 #define pagetok(size) ((size) * (pagesize >> 10))
 
 static void update_ss_data(void*);
+static void init_ss_data(void*);
 
 /*
  *  (This has been stolen from BSD top utility)
@@ -141,9 +146,10 @@ mibss_init(void)
 	memset(&mibss, 0, sizeof(mibss));
 	mibss.index = 1;
 	mibss.errorName = (const u_char *)"systemStats";
+	ss_loaded = 0;
+	ss_idle_hist = hist_metric_get("ssCpuIdle");
 
-	update_ss_data(NULL);
-
+	register_deferred_init(init_ss_data);
 	register_update_interval_timer(update_ss_data);
 }
 
@@ -257,6 +263,7 @@ update_ss_data(void* arg  __unused)
 		mibss.cpuSystem = _round(cpu_states[CP_SYS] + cpu_states[CP_INTR]);
 		mibss.cpuIdle = _round(cpu_states[CP_IDLE]);
 #undef _round
+		hist_add(ss_idle_hist, mibss.cpuIdle);
 	}
 
 	mibss.cpuRawUser = cp_time[CP_USER];
@@ -272,10 +279,23 @@ update_ss_data(void* arg  __unused)
 	oswtch = mibss.rawContexts;
 	last_update = current;
 	cnt++;
+	ss_loaded = 1;
+}
+
+/*
+ * Take the first sample, if neither the deferred init nor a request has
+ * done it yet.
+ */
+static void
+init_ss_data(void *arg __unused)
+{
+
+	if (!ss_loaded)
+		update_ss_data(NULL);
 }
 
-int
-op_systemStats(struct snmp_context *context __unused, struct snmp_value *value,
+static int
+do_systemStats(struct snmp_context *context __unused, struct snmp_value *value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	asn_subid_t which;
@@ -299,6 +319,8 @@ op_systemStats(struct snmp_context *context __unused, struct snmp_value *value,
 		return (SNMP_ERR_RES_UNAVAIL);
 	}
 
+	init_ss_data(NULL);
+
 	ret = SNMP_ERR_NOERROR;
 
 	switch (which) {
@@ -390,3 +412,5 @@ op_systemStats(struct snmp_context *context __unused, struct snmp_value *value,
 	return (ret);
 };
 
+OPSTAT_HANDLER(systemStats, OPSTAT_SYSTEMSTATS)
+
@@ -85,8 +85,8 @@ set_cDate(void)
 		mibver.cDate[end] = '\0';
 }
 
-int
-op_version(struct snmp_context * context __unused, struct snmp_value * value,
+static int
+do_version(struct snmp_context * context __unused, struct snmp_value * value,
 	u_int sub, u_int iidx __unused, enum snmp_op op)
 {
 	asn_subid_t which;
@@ -145,3 +145,5 @@ op_version(struct snmp_context * context __unused, struct snmp_value * value,
 
 	return (ret);
 };
+
+OPSTAT_HANDLER(version, OPSTAT_VERSION)
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#include <sys/types.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "snmp_ucd.h"
+
+/*
+ * SNMP handler statistics.
+ *
+ * When opStatsEnable is set, every instrumented op_* handler counts its
+ * GET, GETNEXT and SET requests and their total latency, and puts the
+ * latency into a log2 histogram: bucket 0 is under 1 microsecond, bucket
+ * n counts latencies from 2^(n-1) to 2^n microseconds, and the last
+ * bucket also counts anything longer. When disabled a handler only tests
+ * the flag.
+ */
+
+/* Operations counted, in the order of the opHistTable index. */
+enum {
+	OPSTAT_OP_GET,
+	OPSTAT_OP_GETNEXT,
+	OPSTAT_OP_SET,
+	OPSTAT_NOPS
+};
+
+struct opstat {
+	uint64_t	count[OPSTAT_NOPS];
+	uint64_t	time[OPSTAT_NOPS];	/* Total, in microseconds. */
+	uint64_t	hist[OPSTAT_NOPS][OPSTAT_BUCKETS];
+};
+
+/*
+ * Handlers compiled in. The others have no rows, the index of a handler
+ * is the same in all builds.
+ */
+static const char *opstat_names[OPSTAT_NHANDLERS] = {
+	[OPSTAT_CONFIG] = "config",
+#ifndef WITHOUT_PR
+	[OPSTAT_PRTABLE] = "prTable",
+#endif
+	[OPSTAT_MEMORY] = "memory",
+#ifndef WITHOUT_EXT
+	[OPSTAT_EXTTABLE] = "extTable",
+#endif
+#ifndef WITHOUT_DISK
+	[OPSTAT_DSKTABLE] = "dskTable",
+#endif
+	[OPSTAT_LATABLE] = "laTable",
+	[OPSTAT_SYSTEMSTATS] = "systemStats",
+#ifndef WITHOUT_DIO
+	[OPSTAT_DISKIOTABLE] = "diskIOTable",
+#endif
+	[OPSTAT_VERSION] = "version",
+};
+
+static struct opstat opstats[OPSTAT_NHANDLERS];
+
+u_int opstat_enable;
+
+void
+opstat_start(struct timespec *ts)
+{
+
+	clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+void
+opstat_end(u_int handler, enum snmp_op op, const struct timespec *start)
+{
+	struct opstat *st;
+	struct timespec ts;
+	uint64_t us;
+	u_int i, bucket;
+
+	switch (op) {
+	case SNMP_OP_GET:
+		i = OPSTAT_OP_GET;
+		break;
+	case SNMP_OP_GETNEXT:
+		i = OPSTAT_OP_GETNEXT;
+		break;
+	case SNMP_OP_SET:
+		i = OPSTAT_OP_SET;
+		break;
+	default:
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	us = (ts.tv_sec - start->tv_sec) * 1000000 +
+	    (ts.tv_nsec - start->tv_nsec) / 1000;
+	bucket = us == 0 ? 0 : flsll(us);
+	if (bucket >= OPSTAT_BUCKETS)
+		bucket = OPSTAT_BUCKETS - 1;
+
+	st = &opstats[handler];
+	st->count[i]++;
+	st->time[i] += us;
+	st->hist[i][bucket]++;
+}
+
+void
+opstat_reset(void)
+{
+
+	memset(opstats, 0, sizeof(opstats));
+}
+
+/* The first handler compiled in starting from h. */
+static u_int
+opstat_next(u_int h)
+{
+
+	while (h < OPSTAT_NHANDLERS && opstat_names[h] == NULL)
+		h++;
+	return (h);
+}
+
+int
+op_opStatsTable(struct snmp_context * context __unused,
+	struct snmp_value * value, u_int sub, u_int iidx __unused,
+	enum snmp_op op)
+{
+	struct opstat *st;
+	asn_subid_t which;
+	u_int h;
+	int ret;
+
+	which = value->var.subs[sub - 1];
+
+	switch (op) {
+	case SNMP_OP_GETNEXT:
+		h = opstat_next(value->var.len - sub == 0 ? 0 :
+		    value->var.subs[sub]);
+		if (h >= OPSTAT_NHANDLERS)
+			return (SNMP_ERR_NOSUCHNAME);
+		value->var.len = sub + 1;
+		value->var.subs[sub] = h + 1;
+		break;
+
+	case SNMP_OP_GET:
+		if (value->var.len - sub != 1)
+			return (SNMP_ERR_NOSUCHNAME);
+		h = value->var.subs[sub];
+		if (h == 0 || h > OPSTAT_NHANDLERS ||
+		    opstat_names[h - 1] == NULL)
+			return (SNMP_ERR_NOSUCHNAME);
+		h--;
+		break;
+
+	case SNMP_OP_SET:
+		return (SNMP_ERR_NOT_WRITEABLE);
+
+	case SNMP_OP_ROLLBACK:
+	case SNMP_OP_COMMIT:
+		return (SNMP_ERR_NOERROR);
+
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+
+	st = &opstats[h];
+	ret = SNMP_ERR_NOERROR;
+
+	switch (which) {
+	case LEAF_opStatsIndex:
+		value->v.integer = h + 1;
+		break;
+
+	case LEAF_opStatsHandler:
+		ret = string_get(value, (const u_char *)opstat_names[h], -1);
+		break;
+
+	case LEAF_opStatsGets:
+		value->v.counter64 = st->count[OPSTAT_OP_GET];
+		break;
+
+	case LEAF_opStatsGetNexts:
+		value->v.counter64 = st->count[OPSTAT_OP_GETNEXT];
+		break;
+
+	case LEAF_opStatsSets:
+		value->v.counter64 = st->count[OPSTAT_OP_SET];
+		break;
+
+	case LEAF_opStatsGetTime:
+		value->v.counter64 = st->time[OPSTAT_OP_GET];
+		break;
+
+	case LEAF_opStatsGetNextTime:
+		value->v.counter64 = st->time[OPSTAT_OP_GETNEXT];
+		break;
+
+	case LEAF_opStatsSetTime:
+		value->v.counter64 = st->time[OPSTAT_OP_SET];
+		break;
+
+	default:
+		ret = SNMP_ERR_RES_UNAVAIL;
+		break;
+	}
+
+	return (ret);
+}
+
+/*
+ * Find the histogram bucket following the (handler, op, bucket) index in
+ * the oid. The index values are 1-based, except for the bucket.
+ */
+static int
+next_opHist(const struct asn_oid *oid, u_int sub, u_int *hp, u_int *op,
+    u_int *bp)
+{
+	asn_subid_t idx[3];
+	u_int i, n;
+
+	n = oid->len - sub;
+	if (n > 3)
+		n = 3;
+	for (i = 0; i < 3; i++)
+		idx[i] = i < n ? oid->subs[sub + i] : 0;
+
+	*op = *bp = 0;
+	if (n == 0 || idx[0] == 0) {
+		*hp = 0;
+		goto found;
+	}
+	*hp = idx[0] - 1;
+	if (*hp >= OPSTAT_NHANDLERS)
+		return (-1);
+	if (opstat_names[*hp] == NULL || n == 1 || idx[1] == 0)
+		goto found;
+	*op = idx[1] - 1;
+	if (*op >= OPSTAT_NOPS) {
+		*op = 0;
+		goto next_handler;
+	}
+	if (n == 2)
+		goto found;
+	if (idx[2] < OPSTAT_BUCKETS - 1) {
+		*bp = idx[2] + 1;
+		goto found;
+	}
+	if (++*op < OPSTAT_NOPS)
+		goto found;
+	*op = 0;
+next_handler:
+	++*hp;
+found:
+	/* Handlers not compiled in have no rows. */
+	if (*hp < OPSTAT_NHANDLERS && opstat_names[*hp] == NULL) {
+		*hp = opstat_next(*hp);
+		*op = *bp = 0;
+	}
+	return (*hp < OPSTAT_NHANDLERS ? 0 : -1);
+}
+
+int
+op_opHistTable(struct snmp_context * context __unused,
+	struct snmp_value * value, u_int sub, u_int iidx __unused,
+	enum snmp_op op)
+{
+	asn_subid_t which;
+	u_int h, o, b;
+	int ret;
+
+	which = value->var.subs[sub - 1];
+
+	switch (op) {
+	case SNMP_OP_GETNEXT:
+		if (next_opHist(&value->var, sub, &h, &o, &b) == -1)
+			return (SNMP_ERR_NOSUCHNAME);
+		value->var.len = sub + 3;
+		value->var.subs[sub] = h + 1;
+		value->var.subs[sub + 1] = o + 1;
+		value->var.subs[sub + 2] = b;
+		break;
+
+	case SNMP_OP_GET:
+		if (value->var.len - sub != 3)
+			return (SNMP_ERR_NOSUCHNAME);
+		h = value->var.subs[sub];
+		o = value->var.subs[sub + 1];
+		b = value->var.subs[sub + 2];
+		if (h == 0 || h > OPSTAT_NHANDLERS ||
+		    opstat_names[h - 1] == NULL || o == 0 ||
+		    o > OPSTAT_NOPS || b >= OPSTAT_BUCKETS)
+			return (SNMP_ERR_NOSUCHNAME);
+		h--;
+		o--;
+		break;
+
+	case SNMP_OP_SET:
+		return (SNMP_ERR_NOT_WRITEABLE);
+
+	case SNMP_OP_ROLLBACK:
+	case SNMP_OP_COMMIT:
+		return (SNMP_ERR_NOERROR);
+
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+
+	ret = SNMP_ERR_NOERROR;
+
+	switch (which) {
+	case LEAF_opHistBucket:
+		value->v.integer = b;
+		break;
+
+	case LEAF_opHistCount:
+		value->v.counter64 = opstats[h].hist[o][b];
+		break;
+
+	default:
+		ret = SNMP_ERR_RES_UNAVAIL;
+		break;
+	}
+
+	return (ret);
+}
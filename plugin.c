@@ -0,0 +1,562 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/queue.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "snmp_ucd.h"
+#include "ucd_plugin.h"
+
+/*
+ * Runner of in-process plugin checks.
+ *
+ * Plugins are run one at a time on a worker thread, so a slow check does
+ * not block bsnmpd. Completed jobs are passed back via a pipe registered
+ * with fd_select(), so owners are notified in the main thread only.
+ *
+ * A thread can not be killed safely, so when a plugin misses its deadline
+ * the worker is abandoned: the job is failed, a new worker is started for
+ * other jobs, and the old one exits when the plugin eventually returns.
+ *
+ * On unload the current worker is waited for a limited time only, and
+ * workers still in plugins are left behind. They see that the engine
+ * generation has changed and exit without touching the jobs or the
+ * notification pipe, and the module is kept mapped for them.
+ */
+
+#define PLUGIN_OUTPUT_MAX	4096
+#define PLUGIN_MAX_ABANDONED	4	/* Max workers stuck in plugins. */
+#define PLUGIN_FINI_WAIT	1	/* Seconds to wait for the worker. */
+
+struct plugin_job;
+
+struct plugin {
+	void			*dl;
+	const struct ucd_plugin	*abi;
+	char			*path;
+	char			*args;
+	void			*ctx;
+	int			inited;		/* init() has succeeded. */
+	int			closed;		/* The owner is gone. */
+	struct plugin_job	*job;		/* Job in flight. */
+	plugin_done_f		done_f;
+	void			*arg;
+};
+
+enum {
+	JOB_QUEUED,
+	JOB_RUNNING,
+	JOB_DONE,
+};
+
+struct plugin_job {
+	TAILQ_ENTRY(plugin_job)	link;
+	struct plugin		*pl;
+	int			state;
+	int			abandoned;	/* The deadline is missed. */
+	void			*timer_id;
+	int			result;
+	char			output[PLUGIN_OUTPUT_MAX];
+	struct rusage		ru;		/* CPU used by the run. */
+};
+
+TAILQ_HEAD(plugin_job_list, plugin_job);
+
+struct plugin_worker {
+	pthread_t		thread;
+	int			abandoned;
+	int			exited;
+	u_int			gen;		/* Engine it works for. */
+};
+
+/* Protects the job lists and the job and worker states. */
+static pthread_mutex_t plugin_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t plugin_cond = PTHREAD_COND_INITIALIZER;
+static struct plugin_job_list plugin_queue =
+    TAILQ_HEAD_INITIALIZER(plugin_queue);	/* Jobs to run. */
+static struct plugin_job_list plugin_done =
+    TAILQ_HEAD_INITIALIZER(plugin_done);	/* Jobs that have run. */
+static int plugin_stopping;
+static u_int plugin_gen;	/* Changed when the engine is stopped. */
+
+/* Used by the main thread only. */
+static struct plugin_worker *plugin_worker;	/* Current worker. */
+static int plugin_nabandoned;
+static int plugin_notify[2] = { -1, -1 };
+static void *plugin_notify_id;
+
+static void *
+plugin_worker_main(void *arg)
+{
+	struct plugin_worker *w;
+	struct plugin_job *job;
+	struct plugin *pl;
+	struct rusage ru0, ru1;
+	int abandoned;
+	char c;
+
+	w = (struct plugin_worker *)arg;
+	c = 0;
+
+	pthread_mutex_lock(&plugin_mtx);
+	for (;;) {
+		while (!w->abandoned && !plugin_stopping &&
+		    TAILQ_EMPTY(&plugin_queue))
+			pthread_cond_wait(&plugin_cond, &plugin_mtx);
+		if (w->abandoned || plugin_stopping)
+			break;
+		job = TAILQ_FIRST(&plugin_queue);
+		TAILQ_REMOVE(&plugin_queue, job, link);
+		job->state = JOB_RUNNING;
+		pthread_mutex_unlock(&plugin_mtx);
+
+		/* The plugin is not freed while its job is in flight. */
+		pl = job->pl;
+		getrusage(RUSAGE_THREAD, &ru0);
+		if (!pl->inited) {
+			if (pl->abi->init == NULL ||
+			    pl->abi->init(pl->args, &pl->ctx) == 0)
+				pl->inited = 1;
+		}
+		if (pl->inited) {
+			job->output[0] = '\0';
+			job->result = pl->abi->run(pl->ctx, job->output,
+			    sizeof(job->output));
+			job->output[sizeof(job->output) - 1] = '\0';
+		} else {
+			job->result = 127;
+			strlcpy(job->output, "Plugin initialization failed",
+			    sizeof(job->output));
+		}
+		getrusage(RUSAGE_THREAD, &ru1);
+		memset(&job->ru, 0, sizeof(job->ru));
+		timersub(&ru1.ru_utime, &ru0.ru_utime, &job->ru.ru_utime);
+		timersub(&ru1.ru_stime, &ru0.ru_stime, &job->ru.ru_stime);
+
+		pthread_mutex_lock(&plugin_mtx);
+		if (w->gen != plugin_gen) {
+			/*
+			 * The engine has been stopped while the plugin was
+			 * running. The job, the plugin and the pipe are gone
+			 * or no longer ours: leave them alone.
+			 */
+			break;
+		}
+		job->state = JOB_DONE;
+		TAILQ_INSERT_TAIL(&plugin_done, job, link);
+		/* If the pipe is full, the main thread will be woken anyway. */
+		(void)write(plugin_notify[1], &c, 1);
+	}
+	abandoned = w->abandoned;
+	w->exited = 1;
+	pthread_cond_broadcast(&plugin_cond);
+	pthread_mutex_unlock(&plugin_mtx);
+
+	/* Abandoned workers are detached and nobody waits for them. */
+	if (abandoned)
+		free(w);
+	return (NULL);
+}
+
+static int
+plugin_worker_start(void)
+{
+	struct plugin_worker *w;
+	sigset_t all, oset;
+	int error;
+
+	w = malloc(sizeof(*w));
+	if (w == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (-1);
+	}
+	memset(w, 0, sizeof(*w));
+	w->gen = plugin_gen;
+
+	/* Signals are handled by the main thread. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &oset);
+	error = pthread_create(&w->thread, NULL, plugin_worker_main, w);
+	pthread_sigmask(SIG_SETMASK, &oset, NULL);
+	if (error != 0) {
+		syslog(LOG_ERR, "pthread_create failed: %s: %s", __func__,
+		    strerror(error));
+		free(w);
+		return (-1);
+	}
+	plugin_worker = w;
+	return (0);
+}
+
+static void
+plugin_free(struct plugin *pl)
+{
+
+	if (pl->inited && pl->abi->fini != NULL)
+		pl->abi->fini(pl->ctx);
+	dlclose(pl->dl);
+	free(pl->path);
+	free(pl->args);
+	free(pl);
+}
+
+/*
+ * The job has missed its deadline.
+ */
+static void
+plugin_timeout(void *arg)
+{
+	struct plugin_job *job;
+	struct plugin *pl;
+	int queued;
+
+	job = (struct plugin_job *)arg;
+	job->timer_id = NULL;
+	pl = job->pl;
+
+	pthread_mutex_lock(&plugin_mtx);
+	switch (job->state) {
+	case JOB_QUEUED:
+		/* Has not even started. */
+		TAILQ_REMOVE(&plugin_queue, job, link);
+		pthread_mutex_unlock(&plugin_mtx);
+		pl->job = NULL;
+		free(job);
+		break;
+	case JOB_RUNNING:
+		/* Only the current worker runs jobs that are not abandoned. */
+		job->abandoned = 1;
+		/*
+		 * Detach before unlocking: once the worker sees abandoned it
+		 * may free itself at any time.
+		 */
+		plugin_worker->abandoned = 1;
+		pthread_detach(plugin_worker->thread);
+		queued = !TAILQ_EMPTY(&plugin_queue);
+		pthread_mutex_unlock(&plugin_mtx);
+		plugin_worker = NULL;
+		plugin_nabandoned++;
+		syslog(LOG_WARNING, "plugin `%s' has not returned in time, "
+		    "abandoning the worker", pl->path);
+		/* Jobs queued behind the stuck one need a new worker. */
+		if (queued && plugin_nabandoned < PLUGIN_MAX_ABANDONED)
+			plugin_worker_start();
+		break;
+	default:
+		/* Done, the result is on the way. */
+		pthread_mutex_unlock(&plugin_mtx);
+		return;
+	}
+
+	pl->done_f(pl->arg, 127, "", 1, NULL);
+}
+
+/*
+ * Pass the results of completed jobs to their owners.
+ */
+static void
+plugin_notify_read(int fd, void *arg __unused)
+{
+	struct plugin_job_list list;
+	struct plugin_job *job;
+	struct plugin *pl;
+	char buf[64];
+
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+
+	TAILQ_INIT(&list);
+	pthread_mutex_lock(&plugin_mtx);
+	TAILQ_CONCAT(&list, &plugin_done, link);
+	pthread_mutex_unlock(&plugin_mtx);
+
+	while ((job = TAILQ_FIRST(&list)) != NULL) {
+		TAILQ_REMOVE(&list, job, link);
+		pl = job->pl;
+		pl->job = NULL;
+		if (job->timer_id != NULL)
+			timer_stop(job->timer_id);
+		if (job->abandoned)
+			plugin_nabandoned--;	/* Already failed. */
+		else if (!pl->closed)
+			pl->done_f(pl->arg, job->result, job->output, 0,
+			    &job->ru);
+		if (pl->closed)
+			plugin_free(pl);
+		free(job);
+	}
+}
+
+/*
+ * Load the plugin. done_f is called with the result of every run.
+ */
+struct plugin *
+plugin_open(const u_char *path, const u_char *args, plugin_done_f done_f,
+    void *arg)
+{
+	struct plugin *pl;
+
+	pl = malloc(sizeof(*pl));
+	if (pl == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (NULL);
+	}
+	memset(pl, 0, sizeof(*pl));
+	pl->path = strdup((const char *)path);
+	pl->args = strdup(args != NULL ? (const char *)args : "");
+	if (pl->path == NULL || pl->args == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		goto fail;
+	}
+
+	pl->dl = dlopen(pl->path, RTLD_NOW | RTLD_LOCAL);
+	if (pl->dl == NULL) {
+		syslog(LOG_ERR, "failed to load plugin: %s: %s", __func__,
+		    dlerror());
+		goto fail;
+	}
+	pl->abi = dlsym(pl->dl, UCD_PLUGIN_SYMBOL);
+	if (pl->abi == NULL || pl->abi->abi != UCD_PLUGIN_ABI ||
+	    pl->abi->run == NULL) {
+		syslog(LOG_ERR, "%s is not a plugin of ABI version %d: %s",
+		    pl->path, UCD_PLUGIN_ABI, __func__);
+		dlclose(pl->dl);
+		goto fail;
+	}
+	pl->done_f = done_f;
+	pl->arg = arg;
+	return (pl);
+fail:
+	free(pl->path);
+	free(pl->args);
+	free(pl);
+	return (NULL);
+}
+
+/*
+ * Queue the plugin run. It fails if it does not complete in timeout
+ * seconds (0 means no timeout). Returns -1 if the plugin can not be run,
+ * e.g. it is still stuck in the previous run.
+ */
+int
+plugin_run(struct plugin *pl, u_int timeout)
+{
+	struct plugin_job *job;
+
+	if (pl->job != NULL)
+		return (-1);
+
+	if (plugin_worker == NULL) {
+		if (plugin_notify_id == NULL)
+			return (-1);
+		if (plugin_nabandoned >= PLUGIN_MAX_ABANDONED) {
+			syslog(LOG_ERR, "too many plugins are stuck: %s",
+			    __func__);
+			return (-1);
+		}
+		if (plugin_worker_start() == -1)
+			return (-1);
+	}
+
+	job = malloc(sizeof(*job));
+	if (job == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (-1);
+	}
+	memset(job, 0, sizeof(*job));
+	job->pl = pl;
+	job->state = JOB_QUEUED;
+	pl->job = job;
+
+	pthread_mutex_lock(&plugin_mtx);
+	TAILQ_INSERT_TAIL(&plugin_queue, job, link);
+	pthread_cond_broadcast(&plugin_cond);
+	pthread_mutex_unlock(&plugin_mtx);
+
+	if (timeout > 0) {
+		job->timer_id = timer_start(timeout * 100, plugin_timeout, job,
+		    ucd_module);
+	}
+	return (0);
+}
+
+/*
+ * Unload the plugin. The owner is not notified any more. If the plugin is
+ * running, it is unloaded when the run completes.
+ */
+void
+plugin_close(struct plugin *pl)
+{
+	struct plugin_job *job;
+
+	pl->closed = 1;
+	if ((job = pl->job) != NULL) {
+		pthread_mutex_lock(&plugin_mtx);
+		if (job->state != JOB_QUEUED) {
+			pthread_mutex_unlock(&plugin_mtx);
+			return;
+		}
+		TAILQ_REMOVE(&plugin_queue, job, link);
+		pthread_mutex_unlock(&plugin_mtx);
+		if (job->timer_id != NULL)
+			timer_stop(job->timer_id);
+		free(job);
+		pl->job = NULL;
+	}
+	plugin_free(pl);
+}
+
+void
+plugin_init_engine(void)
+{
+
+	/* Workers left by a previous load do not count any more. */
+	plugin_stopping = 0;
+	plugin_nabandoned = 0;
+
+	if (pipe2(plugin_notify, O_CLOEXEC | O_NONBLOCK) == -1) {
+		syslog(LOG_ERR, "failed to pipe: %s: %m", __func__);
+		return;
+	}
+	plugin_notify_id = fd_select(plugin_notify[0], plugin_notify_read,
+	    NULL, ucd_module);
+	if (plugin_notify_id == NULL) {
+		syslog(LOG_ERR, "fd_select failed: %s: %m", __func__);
+		close(plugin_notify[0]);
+		close(plugin_notify[1]);
+		plugin_notify[0] = plugin_notify[1] = -1;
+	}
+}
+
+/*
+ * Keep the module mapped after bsnmpd unloads it: the workers left behind
+ * still run its code when their plugins return.
+ */
+static void
+plugin_pin_module(void)
+{
+	Dl_info info;
+	const char *error;
+
+	if (dladdr((void *)plugin_worker_main, &info) == 0) {
+		syslog(LOG_ERR, "dladdr failed: %s", __func__);
+		return;
+	}
+	if (dlopen(info.dli_fname, RTLD_NOW | RTLD_NOLOAD | RTLD_NODELETE) ==
+	    NULL) {
+		error = dlerror();
+		syslog(LOG_ERR, "failed to pin %s: %s: %s", info.dli_fname,
+		    __func__, error != NULL ? error : "not loaded");
+	}
+}
+
+/*
+ * All plugins should be closed by now. The current worker is given
+ * PLUGIN_FINI_WAIT seconds to finish its plugin, and is abandoned if it
+ * does not, so bsnmpd is never blocked by a plugin.
+ */
+void
+plugin_fini_engine(void)
+{
+	struct plugin_worker *w;
+	struct plugin_job *job;
+	struct timespec deadline;
+	int abandoned;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += PLUGIN_FINI_WAIT;
+
+	w = plugin_worker;
+	plugin_worker = NULL;
+
+	abandoned = 0;
+	pthread_mutex_lock(&plugin_mtx);
+	plugin_stopping = 1;
+	pthread_cond_broadcast(&plugin_cond);
+	if (w != NULL) {
+		while (!w->exited && pthread_cond_timedwait(&plugin_cond,
+		    &plugin_mtx, &deadline) != ETIMEDOUT)
+			;
+		if (!w->exited) {
+			/* It frees itself, w must not be used after unlock. */
+			w->abandoned = 1;
+			pthread_detach(w->thread);
+			abandoned = 1;
+		}
+	}
+	/* Workers still in plugins must not report to us any more. */
+	plugin_gen++;
+	pthread_mutex_unlock(&plugin_mtx);
+
+	if (w != NULL) {
+		if (abandoned) {
+			plugin_nabandoned++;
+			syslog(LOG_WARNING, "plugin worker has not finished, "
+			    "abandoning it: %s", __func__);
+		} else {
+			pthread_join(w->thread, NULL);
+			free(w);
+		}
+	}
+	if (plugin_nabandoned > 0)
+		plugin_pin_module();
+
+	pthread_mutex_lock(&plugin_mtx);
+	while ((job = TAILQ_FIRST(&plugin_done)) != NULL) {
+		TAILQ_REMOVE(&plugin_done, job, link);
+		if (job->timer_id != NULL)
+			timer_stop(job->timer_id);
+		if (job->pl->closed)
+			plugin_free(job->pl);
+		free(job);
+	}
+	pthread_mutex_unlock(&plugin_mtx);
+
+	if (plugin_notify_id != NULL)
+		fd_deselect(plugin_notify_id);
+	plugin_notify_id = NULL;
+	if (plugin_notify[0] != -1) {
+		close(plugin_notify[0]);
+		close(plugin_notify[1]);
+	}
+	plugin_notify[0] = plugin_notify[1] = -1;
+}
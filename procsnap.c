@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#include <sys/param.h>
+#include <sys/sysctl.h>
+#include <sys/user.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "snmp_ucd.h"
+
+/*
+ * Process table snapshot.
+ *
+ * The kern.proc.proc sysctl is read into a buffer kept across calls, so
+ * there is no per scan allocation of the whole process table as with
+ * kvm_getprocs(). The buffer grows geometrically, with headroom for the
+ * processes started between the size estimate and the read. The snapshot
+ * is shared: callers asking for it within the same tick get the same data.
+ */
+
+/* Extra space allocated, in 1/PROCSNAP_SLACK of the needed size. */
+#define PROCSNAP_SLACK		4
+
+/* How many times to retry if the table has grown during the read. */
+#define PROCSNAP_MAXRETRY	5
+
+static struct kinfo_proc *snap;		/* Snapshot buffer. */
+static size_t snap_size;		/* Allocated bytes. */
+static int snap_nprocs = -1;		/* Processes in the snapshot. */
+static uint64_t snap_ticks;		/* When the snapshot was taken. */
+
+static int
+procsnap_grow(size_t need)
+{
+	struct kinfo_proc *p;
+	size_t size;
+
+	size = MAX(snap_size * 2, need + need / PROCSNAP_SLACK);
+	size = MAX(size, sizeof(struct kinfo_proc));
+	p = realloc(snap, size);
+	if (p == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		return (-1);
+	}
+	snap = p;
+	snap_size = size;
+	return (0);
+}
+
+/*
+ * Get the snapshot of all processes. Returns the number of processes or
+ * -1 on error. The data is valid until the next call.
+ */
+int
+procsnap_get(struct kinfo_proc **kpp)
+{
+	size_t len;
+	int mib[3], i;
+
+	if (snap_nprocs >= 0 && snap_ticks == get_ticks()) {
+		*kpp = snap;
+		return (snap_nprocs);
+	}
+
+	mib[0] = CTL_KERN;
+	mib[1] = KERN_PROC;
+	mib[2] = KERN_PROC_PROC;
+	snap_nprocs = -1;
+	for (i = 0; i < PROCSNAP_MAXRETRY; i++) {
+		len = snap_size;
+		if (snap_size > 0 && sysctl(mib, 3, snap, &len, NULL, 0) == 0)
+			break;
+		if (snap_size > 0 && errno != ENOMEM) {
+			syslog(LOG_ERR, "sysctl kern.proc.proc failed: %s: %m",
+			    __func__);
+			return (-1);
+		}
+		/* Estimate the size. */
+		len = 0;
+		if (sysctl(mib, 3, NULL, &len, NULL, 0) == -1) {
+			syslog(LOG_ERR, "sysctl kern.proc.proc failed: %s: %m",
+			    __func__);
+			return (-1);
+		}
+		if (procsnap_grow(len) == -1)
+			return (-1);
+	}
+	if (i == PROCSNAP_MAXRETRY) {
+		syslog(LOG_ERR, "process table is growing too fast: %s",
+		    __func__);
+		return (-1);
+	}
+	if (len > 0 && snap->ki_structsize != sizeof(struct kinfo_proc)) {
+		syslog(LOG_ERR, "kinfo_proc size mismatch: %s", __func__);
+		return (-1);
+	}
+
+	snap_nprocs = len / sizeof(struct kinfo_proc);
+	snap_ticks = get_ticks();
+	*kpp = snap;
+	return (snap_nprocs);
+}
+
+/*
+ * Get the process by pid, bypassing the snapshot. Returns -1 if there is
+ * no such process.
+ */
+int
+procsnap_getpid(pid_t pid, struct kinfo_proc *kp)
+{
+	size_t len;
+	int mib[4];
+
+	mib[0] = CTL_KERN;
+	mib[1] = KERN_PROC;
+	mib[2] = KERN_PROC_PID;
+	mib[3] = pid;
+	len = sizeof(*kp);
+	if (sysctl(mib, 4, kp, &len, NULL, 0) == -1 || len != sizeof(*kp))
+		return (-1);
+	return (0);
+}
+
+/*
+ * Get the command line of the process, with arguments separated by spaces.
+ */
+int
+procsnap_getargs(pid_t pid, char *buf, size_t size)
+{
+	size_t len, i;
+	int mib[4];
+
+	mib[0] = CTL_KERN;
+	mib[1] = KERN_PROC;
+	mib[2] = KERN_PROC_ARGS;
+	mib[3] = pid;
+	len = size - 1;
+	if (sysctl(mib, 4, buf, &len, NULL, 0) == -1 && errno != ENOMEM)
+		return (-1);
+	if (len == 0)
+		return (-1);	/* No arguments, e.g. a system process. */
+	if (buf[len - 1] == '\0')
+		len--;
+	for (i = 0; i < len; i++) {
+		if (buf[i] == '\0')
+			buf[i] = ' ';
+	}
+	buf[len] = '\0';
+	return (0);
+}
+
+void
+procsnap_fini(void)
+{
+
+	free(snap);
+	snap = NULL;
+	snap_size = 0;
+	snap_nprocs = -1;
+}
@@ -36,7 +36,7 @@
 #include "snmp_ucd.h"
 
 /* our module handle */
-static struct lmodule *module;
+struct lmodule *ucd_module;
 
 /* OIDs */
 static const struct asn_oid oid_ucdavis = OIDX_ucdavis;
@@ -46,6 +46,10 @@ static u_int ucdavis_index = 0;
 
 /* timers id */
 static void *update_interval_timer, *ext_check_interval_timer;
+static void *sample_interval_timer, *deferred_init_timer;
+
+/* Sample interval in ticks. */
+#define SAMPLE_INTERVAL	100
 
 struct timer_hook {
 	void	(*h_func)(void*);
@@ -58,6 +62,10 @@ static struct timer_hook_list update_interval_timer_hook_list =
     STAILQ_HEAD_INITIALIZER(update_interval_timer_hook_list);
 static struct timer_hook_list ext_check_interval_timer_hook_list =
     STAILQ_HEAD_INITIALIZER(ext_check_interval_timer_hook_list);
+static struct timer_hook_list sample_interval_timer_hook_list =
+    STAILQ_HEAD_INITIALIZER(sample_interval_timer_hook_list);
+static struct timer_hook_list deferred_init_hook_list =
+    STAILQ_HEAD_INITIALIZER(deferred_init_hook_list);
 
 static void
 register_timer(struct timer_hook_list * hooks, void (*hook_f)(void*))
@@ -84,7 +92,25 @@ void
 register_ext_check_interval_timer(void (*hook_f)(void*))
 {
 
-	register_timer(&update_interval_timer_hook_list, hook_f);
+	register_timer(&ext_check_interval_timer_hook_list, hook_f);
+}
+
+void
+register_sample_interval_timer(void (*hook_f)(void*))
+{
+
+	register_timer(&sample_interval_timer_hook_list, hook_f);
+}
+
+/*
+ * Register the first data collection of a group, run after the module is
+ * started instead of in ucd_init(), so bsnmpd does not wait for it.
+ */
+void
+register_deferred_init(void (*hook_f)(void*))
+{
+
+	register_timer(&deferred_init_hook_list, hook_f);
 }
 
 static void
@@ -99,48 +125,107 @@ run_timer_hooks(void* arg)
 	    hook->h_func(NULL);
 }
 
+/*
+ * Start the repeat timer running the hooks. Hook lists of the groups that
+ * are compiled out are empty and get no timer.
+ */
+static void *
+start_timer(struct timer_hook_list *hooks, u_int interval)
+{
+
+	if (STAILQ_EMPTY(hooks))
+		return (NULL);
+	return (timer_start_repeat(interval, interval, run_timer_hooks, hooks,
+	    ucd_module));
+}
+
+static void
+stop_timer(void **timer)
+{
+
+	if (*timer != NULL)
+		timer_stop(*timer);
+	*timer = NULL;
+}
+
+/*
+ * Run the next deferred init hook, one per tick, so requests arriving in
+ * the meantime are served between them.
+ */
+static void
+run_deferred_init(void *arg __unused)
+{
+	struct timer_hook *hook;
+
+	deferred_init_timer = NULL;	/* One-shot timer is gone. */
+	hook = STAILQ_FIRST(&deferred_init_hook_list);
+	if (hook == NULL)
+		return;
+	STAILQ_REMOVE_HEAD(&deferred_init_hook_list, h_link);
+	hook->h_func(NULL);
+	free(hook);
+	if (!STAILQ_EMPTY(&deferred_init_hook_list))
+		deferred_init_timer = timer_start(1, run_deferred_init, NULL,
+		    ucd_module);
+}
+
 void
 restart_update_interval_timer(void)
 {
 
-	timer_stop(update_interval_timer);
-	update_interval_timer = timer_start_repeat(update_interval,
-	    update_interval, run_timer_hooks,
-	    &update_interval_timer_hook_list, module);
+	stop_timer(&update_interval_timer);
+	update_interval_timer = start_timer(&update_interval_timer_hook_list,
+	    update_interval);
 }
 
 void
 restart_ext_check_interval_timer(void)
 {
 
-	timer_stop(ext_check_interval_timer);
-	ext_check_interval_timer = timer_start_repeat(ext_check_interval,
-	    ext_check_interval, run_timer_hooks,
-	    &ext_check_interval_timer_hook_list, module);
+	stop_timer(&ext_check_interval_timer);
+	ext_check_interval_timer = start_timer(
+	    &ext_check_interval_timer_hook_list, ext_check_interval);
 }
 
 /* the initialisation function */
 static int
 ucd_init(struct lmodule *mod, int argc __unused, char *argv[] __unused)
 {
-	module = mod;
+	ucd_module = mod;
 
 	mibconfig_init();
+	mibhist_init();
 	mibla_init();
 	mibmemory_init();
 	mibss_init();
+#ifndef WITHOUT_DISK
 	mibdisk_init();
+#endif
+#ifndef WITHOUT_DIO
+	dsmap_init();
 	mibdio_init();
+#endif
+#if !defined(WITHOUT_EXT) || !defined(WITHOUT_PR)
+	spawn_init_engine();
+#endif
+#ifndef WITHOUT_EXT
+	plugin_init_engine();
 	mibext_init();
+#endif
+#ifndef WITHOUT_PR
 	mibpr_init();
+#endif
 	mibversion_init();
 
-	update_interval_timer = timer_start_repeat(update_interval,
-	    update_interval, run_timer_hooks,
-	    &update_interval_timer_hook_list, module);
-	ext_check_interval_timer = timer_start_repeat(ext_check_interval,
-	    ext_check_interval, run_timer_hooks,
-	    &ext_check_interval_timer_hook_list, module);
+	update_interval_timer = start_timer(&update_interval_timer_hook_list,
+	    update_interval);
+	ext_check_interval_timer = start_timer(
+	    &ext_check_interval_timer_hook_list, ext_check_interval);
+	sample_interval_timer = start_timer(&sample_interval_timer_hook_list,
+	    SAMPLE_INTERVAL);
+	if (!STAILQ_EMPTY(&deferred_init_hook_list))
+		deferred_init_timer = timer_start(1, run_deferred_init, NULL,
+		    ucd_module);
 
 	return (0);
 }
@@ -150,19 +235,49 @@ static void
 ucd_start(void)
 {
 	ucdavis_index = or_register(&oid_ucdavis,
-	    "The MIB module for UCD-SNMP-MIB.", module);
+	    "The MIB module for UCD-SNMP-MIB.", ucd_module);
 }
 
 /* Called, when the module is to be unloaded after it was successfully loaded */
 static int
 ucd_fini(void)
 {
+	struct timer_hook *hook;
 
-	timer_stop(update_interval_timer);
-	timer_stop(ext_check_interval_timer);
+	stop_timer(&deferred_init_timer);
+	while ((hook = STAILQ_FIRST(&deferred_init_hook_list)) != NULL) {
+		STAILQ_REMOVE_HEAD(&deferred_init_hook_list, h_link);
+		free(hook);
+	}
+	stop_timer(&update_interval_timer);
+	stop_timer(&ext_check_interval_timer);
+	stop_timer(&sample_interval_timer);
+#ifndef WITHOUT_EXT
 	mibext_fini();
+#endif
+#ifndef WITHOUT_DISK
 	mibdisk_fini();
+#endif
+#ifndef WITHOUT_DIO
 	mibdio_fini();
+#endif
+#ifndef WITHOUT_PR
+	mibpr_fini();
+	procsnap_fini();
+#endif
+#if !defined(WITHOUT_EXT) || !defined(WITHOUT_PR)
+	fix_fini();
+#endif
+#ifndef WITHOUT_EXT
+	plugin_fini_engine();
+#endif
+#if !defined(WITHOUT_EXT) || !defined(WITHOUT_PR)
+	spawn_fini_engine();
+#endif
+#ifndef WITHOUT_DIO
+	dsmap_fini();
+#endif
+	mibhist_fini();
 	or_unregister(ucdavis_index);
 	return (0);
 }
@@ -30,6 +30,10 @@
 #ifndef SNMP_UCD_H
 #define SNMP_UCD_H
 
+#include <devstat.h>
+#include <stddef.h>
+#include <time.h>
+
 #include <bsnmp/snmpmod.h>
 #include "ucd_tree.h"
 #include "ucd_oid.h"
@@ -42,17 +46,247 @@
 /* Default laConfig value. */
 #define LACONFIG		"12.00"
 
+/* Max number of diskIOTable devices sampled every second. */
+#define DISKIO_MAX_FAST		64
+
+/* Default and max number of history samples kept per metric. */
+#define HIST_SAMPLES		60
+#define HIST_MAX_SAMPLES	8640
+
 /* snmp_ucd.c */
 extern const struct snmp_module config;
+extern struct lmodule *ucd_module;
 
 void register_update_interval_timer(void (*hook_f)(void*));
 void register_ext_check_interval_timer(void (*hook_f)(void*));
+void register_sample_interval_timer(void (*hook_f)(void*));
+void register_deferred_init(void (*hook_f)(void*));
 void restart_update_interval_timer(void);
 void restart_ext_check_interval_timer(void);
 
+/* dsmap.c */
+
+/* Consistent copy of devstat counters. */
+struct dsmap_stat {
+	uint64_t	bytes[DEVSTAT_N_TRANS_FLAGS];
+	uint64_t	operations[DEVSTAT_N_TRANS_FLAGS];
+	struct bintime	busy_time;
+};
+
+extern void dsmap_init(void);
+extern void dsmap_fini(void);
+extern int dsmap_getdevs(struct devstat ***, long *);
+extern void dsmap_read(const struct devstat *, struct dsmap_stat *);
+
+/* procsnap.c */
+
+struct kinfo_proc;
+
+extern int procsnap_get(struct kinfo_proc **);
+extern int procsnap_getpid(pid_t, struct kinfo_proc *);
+extern int procsnap_getargs(pid_t, char *, size_t);
+extern void procsnap_fini(void);
+
+/* spawn.c */
+
+struct rusage;
+
+/* Execution statistics of a command. */
+struct spawn_stats {
+	uint32_t	runs;		/* Times started. */
+	uint32_t	timeouts;	/* Times killed on timeout. */
+	uint32_t	failures;	/* Times failed to start. */
+	uint32_t	completed;	/* Times finished. */
+	uint64_t	last;		/* Last runtime, in ticks. */
+	uint64_t	max;		/* Max runtime, in ticks. */
+	uint64_t	total;		/* Total runtime, in ticks. */
+	uint64_t	utime;		/* User CPU time, in microseconds. */
+	uint64_t	stime;		/* System CPU time, in microseconds. */
+	time_t		start;		/* Last start time. */
+	time_t		end;		/* Last completion time. */
+	uint64_t	_start;		/* Last start time, in ticks. */
+};
+
+/* Statistics exported via SNMP, in the order of the table columns. */
+enum {
+	SPAWN_STAT_RUNS,
+	SPAWN_STAT_TIMEOUTS,
+	SPAWN_STAT_FAILURES,
+	SPAWN_STAT_LAST,
+	SPAWN_STAT_AVG,
+	SPAWN_STAT_MAX,
+	SPAWN_STAT_UTIME,
+	SPAWN_STAT_STIME,
+	SPAWN_STAT_START,
+	SPAWN_STAT_END,
+};
+
+/* Command started by spawn_start(). */
+struct spawn {
+	pid_t		pid;		/* Running process, 0 if none. */
+	int		fd;		/* Captured stdout, -1 if none. */
+	uint64_t	start;		/* Start time, in ticks. */
+	int		timedout;	/* Killed on timeout. */
+	int		status;		/* Exit status. */
+	int		flags;
+#define	SPAWN_DUPLEX	0x01		/* fd is also the command stdin. */
+	int		(*read_f)(void *);	/* Output is readable. */
+	void		(*done_f)(void *);	/* Process has exited. */
+	void		*arg;
+	void		*_fd_id;
+	void		*_timer_id;
+	void		*_reap_id;
+	struct spawn_stats stats;
+};
+
+extern void spawn_init_engine(void);
+extern void spawn_fini_engine(void);
+extern void spawn_init(struct spawn *, int (*)(void *), void (*)(void *),
+    void *);
+extern int spawn_start(struct spawn *, const u_char *, u_int);
+extern void spawn_stop(struct spawn *);
+extern void spawn_stats_start(struct spawn_stats *);
+extern void spawn_stats_end(struct spawn_stats *, int,
+    const struct rusage *);
+extern void spawn_stats_add(struct spawn_stats *,
+    const struct spawn_stats *);
+extern int spawn_stats_get(const struct spawn_stats *, u_int,
+    struct snmp_value *);
+
+/* fix.c */
+
+struct fix_run;
+
+/* Fix command state of an entry. */
+struct fix {
+	struct fix_run		*_run;		/* Fix launched by the entry. */
+	u_int			_attempts;	/* Successive attempts. */
+	uint64_t		_next;		/* Next attempt, in ticks. */
+	int			_delayed;	/* Delays counted, FIX_DELAYED_*. */
+	struct spawn_stats	stats;
+};
+
+extern void fix_init(struct fix *);
+extern void fix_request(struct fix *, const u_char *);
+extern void fix_reset(struct fix *);
+extern void fix_cancel(struct fix *);
+extern void fix_fini(void);
+
+/* plugin.c */
+
+struct plugin;
+
+/* Called with the result of the plugin run. */
+typedef void (*plugin_done_f)(void *arg, int result, const char *output,
+    int timedout, const struct rusage *ru);
+
+extern void plugin_init_engine(void);
+extern void plugin_fini_engine(void);
+extern struct plugin *plugin_open(const u_char *, const u_char *,
+    plugin_done_f, void *);
+extern int plugin_run(struct plugin *, u_int);
+extern void plugin_close(struct plugin *);
+
+/* opstat.c */
+
+/* Instrumented handlers, in the order of the opStatsTable index. */
+enum {
+	OPSTAT_CONFIG,
+	OPSTAT_PRTABLE,
+	OPSTAT_MEMORY,
+	OPSTAT_EXTTABLE,
+	OPSTAT_DSKTABLE,
+	OPSTAT_LATABLE,
+	OPSTAT_SYSTEMSTATS,
+	OPSTAT_DISKIOTABLE,
+	OPSTAT_VERSION,
+	OPSTAT_NHANDLERS
+};
+
+/* Number of log2 latency histogram buckets. */
+#define OPSTAT_BUCKETS		24
+
+extern u_int opstat_enable;
+extern void opstat_start(struct timespec *);
+extern void opstat_end(u_int, enum snmp_op, const struct timespec *);
+extern void opstat_reset(void);
+
+/*
+ * Define the op_<name> handler calling do_<name>, counted as handler id
+ * if opstat_enable is set.
+ */
+#define OPSTAT_HANDLER(name, id)					\
+int									\
+op_##name(struct snmp_context *context, struct snmp_value *value,	\
+    u_int sub, u_int iidx, enum snmp_op op)				\
+{									\
+	struct timespec ts;						\
+	int ret;							\
+									\
+	if (!opstat_enable)						\
+		return (do_##name(context, value, sub, iidx, op));	\
+	opstat_start(&ts);						\
+	ret = do_##name(context, value, sub, iidx, op);			\
+	opstat_end((id), op, &ts);					\
+	return (ret);							\
+}
+
 /* utils.c */
 extern void sysctlval(const char *, u_long*);
 
+/*
+ * Ordered index of a table whose rows are kept in a TAILQ sorted by an
+ * int32_t index, with a walk cursor, so a GETNEXT for the successor of the
+ * last returned row is O(1) and other lookups are a binary search instead
+ * of a list scan. The owner calls table_index_changed() when rows are
+ * added or removed, and rebuilds the index with TABLE_INDEX_UPDATE().
+ */
+struct table_index {
+	void		**rows;		/* Rows ordered by index. */
+	u_int		nrows;
+	u_int		size;		/* Allocated rows. */
+	size_t		off;		/* Offset of the row index. */
+	u_int		gen;		/* Table generation. */
+	u_int		igen;		/* Generation rows were built at. */
+	int		valid;		/* rows is complete. */
+	u_int		cursor;		/* Position of the last returned row. */
+};
+
+#define TABLE_INDEX_INITIALIZER(type, field)				\
+	{ NULL, 0, 0, offsetof(type, field), 0, 0, 0, 0 }
+
+/*
+ * Rebuild the index ti from the rows of type struct type in the TAILQ
+ * head, linked by "link", if it is stale. Sets error to -1 if the index is
+ * not usable and the list has to be scanned, and to 0 otherwise.
+ */
+#define TABLE_INDEX_UPDATE(ti, head, type, error) do {			\
+	struct type *_row;						\
+									\
+	(error) = 0;							\
+	if (table_index_stale(ti)) {					\
+		table_index_clear(ti);					\
+		TAILQ_FOREACH(_row, (head), link) {			\
+			if (table_index_add((ti), _row) == -1) {	\
+				(error) = -1;				\
+				break;					\
+			}						\
+		}							\
+		if ((error) == 0)					\
+			table_index_done(ti);				\
+	}								\
+} while (0)
+
+extern void table_index_changed(struct table_index *);
+extern int table_index_stale(const struct table_index *);
+extern void table_index_clear(struct table_index *);
+extern int table_index_add(struct table_index *, void *);
+extern void table_index_done(struct table_index *);
+extern void *table_index_find(struct table_index *, asn_subid_t);
+extern void *table_index_next(struct table_index *, const struct asn_oid *,
+    u_int);
+extern void table_index_free(struct table_index *);
+
 /* mibconfig.c */
 
 /* Update interval in ticks. */
@@ -67,6 +301,25 @@ extern u_int ext_update_interval;
 /* Ext command execution timeout in sec. */
 extern u_int ext_timeout;
 
+/* diskIOTable device filter: devstat match expressions and name patterns. */
+extern u_char *diskio_match;
+extern u_char *diskio_include;
+extern u_char *diskio_exclude;
+
+/* Number of the busiest diskIOTable devices sampled every second. */
+extern u_int diskio_fast_devices;
+extern u_int ext_max_running;
+extern u_int ext_output_max_bytes;
+extern u_int ext_output_max_lines;
+extern u_int ext_output_budget;
+extern u_int fix_max_per_minute;
+
+/* Full process table scan interval in ticks, prTable counts kqueue events. */
+extern u_int pr_scan_interval;
+
+/* Number of history samples kept per metric. */
+extern u_int hist_samples;
+
 /* __FreeBSD_version value of the running kernel. */
 extern int osreldate;
 
@@ -84,6 +337,7 @@ extern void mibss_init(void);
 /* mibext.c */
 extern void mibext_init(void);
 extern void mibext_fini(void);
+extern void mibext_trim_output(void);
 
 /* mibdisk,c */
 extern void mibdisk_fini(void);
@@ -92,6 +346,7 @@ extern void mibdisk_init(void);
 /* mibdio.c */
 extern void mibdio_fini(void);
 extern void mibdio_init(void);
+extern void mibdio_reset_filter(void);
 
 /* mibpr.c */
 extern void mibpr_init(void);
@@ -100,4 +355,14 @@ extern void mibpr_fini(void);
 /* mibversion.c */
 extern void mibversion_init(void);
 
+/* mibhist.c */
+struct hist_metric;
+
+extern void mibhist_init(void);
+extern void mibhist_fini(void);
+extern void mibhist_resize(void);
+extern struct hist_metric *hist_metric_get(const char *);
+extern void hist_metric_put(struct hist_metric *);
+extern void hist_add(struct hist_metric *, int32_t);
+
 #endif /* SNMP_UCD_H */
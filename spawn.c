@@ -0,0 +1,623 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#include <sys/param.h>
+#include <sys/event.h>
+#include <sys/queue.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <paths.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "snmp_ucd.h"
+
+/*
+ * Process launcher for ext and fix commands.
+ *
+ * Commands are started with vfork(2), so bsnmpd address space is not
+ * copied, in a new process group, so on timeout the parent can kill the
+ * command together with its children. Commands without shell
+ * metacharacters are executed directly, others via /bin/sh -c.
+ *
+ * Nothing is polled: the command output is read when the pipe becomes
+ * readable (fd_select()), process exit is reported by kqueue EVFILT_PROC
+ * and the timeout is a bsnmpd timer.
+ *
+ * With SPAWN_DUPLEX the command stdin and stdout are connected to a
+ * socket, so the caller can also write requests to sp->fd (with
+ * MSG_NOSIGNAL, to survive the command death).
+ */
+
+/* Characters that require the command to be run by the shell. */
+#define SHELL_CHARS	"|&;<>()$`\\\"'*?[]#~=%{}!\n"
+
+static int kq = -1;		/* kqueue for process exit events. */
+static void *kq_id;		/* fd_select() id of kq. */
+
+/* Retry interval of reaping stopped commands, in ticks. */
+#define SPAWN_ORPHAN_RETRY	10
+
+/* Killed command nobody waits for, to be reaped when it exits. */
+struct spawn_orphan {
+	pid_t				pid;
+	LIST_ENTRY(spawn_orphan)	link;
+};
+
+static LIST_HEAD(, spawn_orphan) orphans = LIST_HEAD_INITIALIZER(orphans);
+static void *orphan_timer;
+
+static void spawn_reap(void *);
+static void spawn_orphan_timeout(void *);
+
+/*
+ * Split the command into argv if it can be run without the shell.
+ * Returns NULL otherwise.
+ */
+static char **
+spawn_argv(const char *cmd)
+{
+	char **argv, *buf, *word;
+	size_t len;
+	int n;
+
+	if (strpbrk(cmd, SHELL_CHARS) != NULL)
+		return (NULL);
+
+	len = strlen(cmd) + 1;
+	n = len / 2 + 1;	/* Max number of words. */
+	argv = malloc((n + 1) * sizeof(*argv) + len);
+	if (argv == NULL)
+		return (NULL);
+	buf = (char *)(argv + n + 1);
+	memcpy(buf, cmd, len);
+
+	n = 0;
+	while ((word = strsep(&buf, " \t")) != NULL) {
+		if (*word != '\0')
+			argv[n++] = word;
+	}
+	argv[n] = NULL;
+	if (n == 0) {
+		free(argv);
+		return (NULL);
+	}
+	return (argv);
+}
+
+/*
+ * Watch for the process exit. udata is NULL for processes nobody waits
+ * for any more, which only need to be reaped.
+ */
+static int
+spawn_watch(pid_t pid, void *udata)
+{
+	struct kevent ev;
+
+	EV_SET(&ev, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0,
+	    udata);
+	return (kevent(kq, &ev, 1, NULL, 0, NULL));
+}
+
+static void
+spawn_close_fd(struct spawn *sp)
+{
+
+	if (sp->_fd_id != NULL) {
+		fd_deselect(sp->_fd_id);
+		sp->_fd_id = NULL;
+	}
+	if (sp->fd != -1) {
+		close(sp->fd);
+		sp->fd = -1;
+	}
+}
+
+/*
+ * The command output is readable.
+ */
+static void
+spawn_read(int fd __unused, void *arg)
+{
+	struct spawn *sp;
+
+	sp = (struct spawn *)arg;
+	if (sp->read_f(sp->arg))
+		spawn_close_fd(sp);	/* EOF. */
+}
+
+static void
+spawn_timeout(void *arg)
+{
+	struct spawn *sp;
+
+	sp = (struct spawn *)arg;
+	sp->_timer_id = NULL;
+	if (sp->pid > 0) {
+		killpg(sp->pid, SIGKILL);
+		sp->timedout = 1;
+		sp->stats.timeouts++;
+	}
+}
+
+/*
+ * The process has exited: reap it, read the rest of its output and
+ * notify the owner.
+ */
+static void
+spawn_reap(void *arg)
+{
+	struct spawn *sp;
+	struct rusage ru;
+	pid_t res;
+	int status;
+
+	sp = (struct spawn *)arg;
+	sp->_reap_id = NULL;
+
+	do {
+		res = wait4(sp->pid, &status, WNOHANG, &ru);
+	} while (res == -1 && errno == EINTR);
+
+	if (res == 0) {
+		/* NOTE_EXIT may come before the process becomes a zombie. */
+		sp->_reap_id = timer_start(1, spawn_reap, sp, ucd_module);
+		return;
+	}
+
+	if (res == -1) {
+		syslog(LOG_ERR, "waitpid failed: %s: %m", __func__);
+		sp->status = 127;
+		memset(&ru, 0, sizeof(ru));
+	} else if (sp->timedout || !WIFEXITED(status)) {
+		sp->status = 127;
+	} else {
+		sp->status = WEXITSTATUS(status);
+	}
+	sp->pid = 0;
+	spawn_stats_end(&sp->stats, 0, &ru);
+
+	if (sp->_timer_id != NULL) {
+		timer_stop(sp->_timer_id);
+		sp->_timer_id = NULL;
+	}
+	if (sp->fd != -1) {
+		sp->read_f(sp->arg);
+		if (sp->fd == -1)
+			return;	/* read_f has stopped the spawn. */
+		spawn_close_fd(sp);
+	}
+	if (sp->done_f != NULL)
+		sp->done_f(sp->arg);
+}
+
+/*
+ * Reap the stopped commands that have exited. Like in spawn_reap(),
+ * NOTE_EXIT may come before the process becomes a zombie, so the ones
+ * still running are retried from a timer.
+ */
+static void
+spawn_reap_orphans(void)
+{
+	struct spawn_orphan *op, *tmp;
+	pid_t res;
+
+	LIST_FOREACH_SAFE(op, &orphans, link, tmp) {
+		do {
+			res = waitpid(op->pid, NULL, WNOHANG);
+		} while (res == -1 && errno == EINTR);
+		if (res == 0)
+			continue;
+		LIST_REMOVE(op, link);
+		free(op);
+	}
+
+	if (LIST_EMPTY(&orphans) && orphan_timer != NULL) {
+		timer_stop(orphan_timer);
+		orphan_timer = NULL;
+	} else if (!LIST_EMPTY(&orphans) && orphan_timer == NULL) {
+		orphan_timer = timer_start(SPAWN_ORPHAN_RETRY,
+		    spawn_orphan_timeout, NULL, ucd_module);
+	}
+}
+
+static void
+spawn_orphan_timeout(void *arg __unused)
+{
+
+	orphan_timer = NULL;
+	spawn_reap_orphans();
+}
+
+/*
+ * Hand the killed process over to the orphan list.
+ */
+static void
+spawn_orphan(pid_t pid)
+{
+	struct spawn_orphan *op;
+
+	op = malloc(sizeof(*op));
+	if (op == NULL) {
+		syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+		/* It has been sent SIGKILL, so it should not take long. */
+		while (waitpid(pid, NULL, 0) == -1 && errno == EINTR)
+			;
+		return;
+	}
+	op->pid = pid;
+	LIST_INSERT_HEAD(&orphans, op, link);
+
+	/* It might have already exited. */
+	if (spawn_watch(pid, NULL) == -1)
+		spawn_reap_orphans();
+}
+
+/*
+ * kqueue is readable: process exit events.
+ */
+static void
+spawn_kq_read(int fd __unused, void *arg __unused)
+{
+	static const struct timespec zero = { 0, 0 };
+	struct kevent ev[16];
+	int i, n;
+
+	n = kevent(kq, NULL, 0, ev, sizeof(ev) / sizeof(ev[0]), &zero);
+	if (n == -1 && errno != EINTR)
+		syslog(LOG_ERR, "kevent failed: %s: %m", __func__);
+
+	for (i = 0; i < n; i++) {
+		if (ev[i].filter != EVFILT_PROC)
+			continue;
+		if (ev[i].udata == NULL) {
+			/* Killed by spawn_stop(). */
+			spawn_reap_orphans();
+			continue;
+		}
+		spawn_reap(ev[i].udata);
+	}
+}
+
+/*
+ * Initialize the spawn. read_f is called when the command output is
+ * readable, it should read sp->fd and return 1 on EOF. If read_f is NULL
+ * the output is not captured. done_f is called when the command exits,
+ * unless the owner has stopped the spawn with spawn_stop().
+ */
+void
+spawn_init(struct spawn *sp, int (*read_f)(void *), void (*done_f)(void *),
+    void *arg)
+{
+
+	memset(sp, 0, sizeof(*sp));
+	sp->fd = -1;
+	sp->flags = 0;
+	sp->read_f = read_f;
+	sp->done_f = done_f;
+	sp->arg = arg;
+}
+
+/*
+ * Start the command. It is killed if it has been running longer than
+ * timeout seconds (0 means no timeout). Returns 0 on success and -1 on
+ * failure.
+ */
+int
+spawn_start(struct spawn *sp, const u_char *cmd, u_int timeout)
+{
+	struct sigaction sa;
+	sigset_t all, oset;
+	char **argv;
+	int fd[2], sig, capture;
+	pid_t pid;
+
+	if (kq == -1) {
+		syslog(LOG_ERR, "no kqueue to watch commands: %s", __func__);
+		sp->stats.failures++;
+		return (-1);
+	}
+
+	sp->pid = 0;
+	sp->fd = -1;
+	sp->timedout = 0;
+	sp->status = 127;
+	capture = (sp->read_f != NULL);
+
+	fd[0] = fd[1] = -1;
+	if (capture && (sp->flags & SPAWN_DUPLEX) != 0) {
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0,
+		    fd) == -1) {
+			syslog(LOG_ERR, "failed to socketpair: %s: %m",
+			    __func__);
+			sp->stats.failures++;
+			return (-1);
+		}
+	} else if (capture && pipe2(fd, O_CLOEXEC) == -1) {
+		syslog(LOG_ERR, "failed to pipe: %s: %m", __func__);
+		sp->stats.failures++;
+		return (-1);
+	}
+
+	argv = spawn_argv((const char *)cmd);
+
+	/*
+	 * Block signals, so bsnmpd handlers are not run in the child while
+	 * it shares our address space.
+	 */
+	sigfillset(&all);
+	sigprocmask(SIG_SETMASK, &all, &oset);
+
+	pid = vfork();
+	if (pid == 0) {
+		/* Only async-signal safe calls are allowed here. */
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = SIG_DFL;
+		for (sig = 1; sig < NSIG; sig++)
+			sigaction(sig, &sa, NULL);
+		setpgid(0, 0);
+		if (capture && fd[1] != STDOUT_FILENO) {
+			if (dup2(fd[1], STDOUT_FILENO) == -1)
+				_exit(127);
+		}
+		if (capture && (sp->flags & SPAWN_DUPLEX) != 0) {
+			if (dup2(fd[1], STDIN_FILENO) == -1)
+				_exit(127);
+		}
+		closefrom(STDERR_FILENO + 1);
+		sigprocmask(SIG_SETMASK, &oset, NULL);
+		if (argv != NULL) {
+			execvp(argv[0], argv);
+		} else {
+			execl(_PATH_BSHELL, "sh", "-c", (const char *)cmd,
+			    (char *)NULL);
+		}
+		_exit(127);
+	}
+	sigprocmask(SIG_SETMASK, &oset, NULL);
+	free(argv);
+
+	if (pid == -1) {
+		syslog(LOG_ERR, "Can't fork: %s: %m", __func__);
+		if (capture) {
+			close(fd[0]);
+			close(fd[1]);
+		}
+		sp->stats.failures++;
+		return (-1);
+	}
+
+	sp->pid = pid;
+	sp->start = get_ticks();
+	/* Only commands that have been started are counted as runs. */
+	spawn_stats_start(&sp->stats);
+
+	if (capture) {
+		close(fd[1]);
+		fcntl(fd[0], F_SETFL, O_NONBLOCK);
+		sp->fd = fd[0];
+		sp->_fd_id = fd_select(sp->fd, spawn_read, sp, ucd_module);
+		if (sp->_fd_id == NULL)
+			syslog(LOG_ERR, "fd_select failed: %s: %m", __func__);
+	}
+
+	if (spawn_watch(pid, sp) == -1) {
+		/* The process might have already exited. */
+		if (errno != ESRCH)
+			syslog(LOG_ERR, "kevent failed: %s: %m", __func__);
+		sp->_reap_id = timer_start(1, spawn_reap, sp, ucd_module);
+	}
+
+	if (timeout > 0) {
+		sp->_timer_id = timer_start(timeout * 100, spawn_timeout, sp,
+		    ucd_module);
+	}
+
+	return (0);
+}
+
+/*
+ * Kill the running command and release its resources. The owner is not
+ * notified; the process is reaped when it exits.
+ */
+void
+spawn_stop(struct spawn *sp)
+{
+
+	spawn_close_fd(sp);
+	if (sp->_timer_id != NULL) {
+		timer_stop(sp->_timer_id);
+		sp->_timer_id = NULL;
+	}
+	if (sp->_reap_id != NULL) {
+		timer_stop(sp->_reap_id);
+		sp->_reap_id = NULL;
+	}
+	if (sp->pid <= 0)
+		return;
+
+	killpg(sp->pid, SIGKILL);
+	spawn_orphan(sp->pid);
+	sp->pid = 0;
+	sp->status = 127;
+}
+
+/*
+ * Account the start of a command.
+ */
+void
+spawn_stats_start(struct spawn_stats *st)
+{
+
+	st->runs++;
+	st->start = time(NULL);
+	st->_start = get_ticks();
+}
+
+/*
+ * Account the completion of a command. ru may be NULL if the resource
+ * usage is unknown.
+ */
+void
+spawn_stats_end(struct spawn_stats *st, int timedout, const struct rusage *ru)
+{
+
+	if (timedout)
+		st->timeouts++;
+	st->completed++;
+	st->end = time(NULL);
+	st->last = get_ticks() - st->_start;
+	st->total += st->last;
+	if (st->last > st->max)
+		st->max = st->last;
+	if (ru != NULL) {
+		st->utime += ru->ru_utime.tv_sec * 1000000ULL +
+		    ru->ru_utime.tv_usec;
+		st->stime += ru->ru_stime.tv_sec * 1000000ULL +
+		    ru->ru_stime.tv_usec;
+	}
+}
+
+/*
+ * Add statistics of some runs to the totals.
+ */
+void
+spawn_stats_add(struct spawn_stats *dst, const struct spawn_stats *src)
+{
+
+	dst->runs += src->runs;
+	dst->timeouts += src->timeouts;
+	dst->failures += src->failures;
+	dst->completed += src->completed;
+	dst->total += src->total;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->utime += src->utime;
+	dst->stime += src->stime;
+	if (src->runs > 0)
+		dst->start = src->start;
+	if (src->completed > 0) {
+		dst->last = src->last;
+		dst->end = src->end;
+	}
+}
+
+/*
+ * Get the statistics value. Times are reported in milliseconds and
+ * timestamps in seconds since the Epoch.
+ */
+int
+spawn_stats_get(const struct spawn_stats *st, u_int which,
+    struct snmp_value *value)
+{
+
+	switch (which) {
+	case SPAWN_STAT_RUNS:
+		value->v.uint32 = st->runs;
+		break;
+	case SPAWN_STAT_TIMEOUTS:
+		value->v.uint32 = st->timeouts;
+		break;
+	case SPAWN_STAT_FAILURES:
+		value->v.uint32 = st->failures;
+		break;
+	case SPAWN_STAT_LAST:
+		value->v.integer = MIN(st->last * 10, INT32_MAX);
+		break;
+	case SPAWN_STAT_AVG:
+		value->v.integer = st->completed == 0 ? 0 :
+		    MIN(st->total * 10 / st->completed, INT32_MAX);
+		break;
+	case SPAWN_STAT_MAX:
+		value->v.integer = MIN(st->max * 10, INT32_MAX);
+		break;
+	case SPAWN_STAT_UTIME:
+		value->v.uint32 = st->utime / 1000;
+		break;
+	case SPAWN_STAT_STIME:
+		value->v.uint32 = st->stime / 1000;
+		break;
+	case SPAWN_STAT_START:
+		value->v.uint32 = st->start;
+		break;
+	case SPAWN_STAT_END:
+		value->v.uint32 = st->end;
+		break;
+	default:
+		return (SNMP_ERR_RES_UNAVAIL);
+	}
+	return (SNMP_ERR_NOERROR);
+}
+
+void
+spawn_init_engine(void)
+{
+
+	kq = kqueue();
+	if (kq == -1) {
+		syslog(LOG_ERR, "kqueue failed: %s: %m", __func__);
+		return;
+	}
+	kq_id = fd_select(kq, spawn_kq_read, NULL, ucd_module);
+	if (kq_id == NULL) {
+		syslog(LOG_ERR, "fd_select failed: %s: %m", __func__);
+		close(kq);
+		kq = -1;
+	}
+}
+
+void
+spawn_fini_engine(void)
+{
+	struct spawn_orphan *op;
+
+	if (orphan_timer != NULL)
+		timer_stop(orphan_timer);
+	orphan_timer = NULL;
+	while ((op = LIST_FIRST(&orphans)) != NULL) {
+		waitpid(op->pid, NULL, WNOHANG);
+		LIST_REMOVE(op, link);
+		free(op);
+	}
+	if (kq_id != NULL)
+		fd_deselect(kq_id);
+	kq_id = NULL;
+	if (kq != -1)
+		close(kq);
+	kq = -1;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2026 Mikolaj Golub
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef UCD_PLUGIN_H
+#define UCD_PLUGIN_H
+
+#include <stddef.h>
+
+/*
+ * ABI of bsnmp-ucd plugin checks (extPlugin).
+ *
+ * A plugin is a shared object exporting a struct ucd_plugin named
+ * "ucd_plugin". init and run are called from a worker thread, fini from
+ * the bsnmpd main thread, and calls for the same context never overlap.
+ * A run that misses its deadline is abandoned but keeps running, so runs
+ * for different contexts may overlap then.
+ *
+ * init is called before the first run with the extCommand string as an
+ * argument. It returns 0 on success and stores its context in *ctxp.
+ * init and fini may be NULL.
+ *
+ * run performs the check. It writes the NUL-terminated output (possibly
+ * several lines) into buf of size bytes and returns the result exported
+ * via extResult (0 means OK).
+ *
+ * fini releases the context.
+ */
+
+#define UCD_PLUGIN_ABI		1
+#define UCD_PLUGIN_SYMBOL	"ucd_plugin"
+
+struct ucd_plugin {
+	int	abi;			/* UCD_PLUGIN_ABI */
+	int	(*init)(const char *args, void **ctxp);
+	int	(*run)(void *ctx, char *buf, size_t size);
+	void	(*fini)(void *ctx);
+};
+
+#endif /* UCD_PLUGIN_H */
@@ -30,6 +30,8 @@
 #include <sys/types.h>
 #include <sys/sysctl.h>
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <syslog.h>
 
 #include "snmp_ucd.h"
@@ -44,3 +46,141 @@ sysctlval(const char *name, u_long *val)
   	if (sysctlbyname(name, val, &len, NULL, 0) != 0)
 		syslog(LOG_WARNING, "%s(\"%s\"): %m", __func__, name);
 }
+
+/*
+ * Ordered table index with a walk cursor.
+ */
+
+#define ROW_INDEX(ti, row)	(*(const int32_t *)((const char *)(row) + \
+				    (ti)->off))
+
+void
+table_index_changed(struct table_index *ti)
+{
+
+	ti->gen++;
+}
+
+int
+table_index_stale(const struct table_index *ti)
+{
+
+	return (!ti->valid || ti->igen != ti->gen);
+}
+
+void
+table_index_clear(struct table_index *ti)
+{
+
+	ti->nrows = 0;
+	ti->valid = 0;
+	ti->cursor = 0;
+}
+
+/*
+ * Add the next row, in the index order.
+ */
+int
+table_index_add(struct table_index *ti, void *row)
+{
+	void **p;
+	u_int size;
+
+	if (ti->nrows == ti->size) {
+		size = ti->size > 0 ? ti->size * 2 : 64;
+		p = realloc(ti->rows, size * sizeof(*p));
+		if (p == NULL) {
+			syslog(LOG_ERR, "failed to malloc: %s: %m", __func__);
+			return (-1);
+		}
+		ti->rows = p;
+		ti->size = size;
+	}
+	ti->rows[ti->nrows++] = row;
+	return (0);
+}
+
+void
+table_index_done(struct table_index *ti)
+{
+
+	ti->igen = ti->gen;
+	ti->valid = 1;
+}
+
+/*
+ * Return the position of the first row with index greater than or equal
+ * to idx.
+ */
+static u_int
+table_index_search(const struct table_index *ti, asn_subid_t idx)
+{
+	u_int lo, hi, mid;
+
+	lo = 0;
+	hi = ti->nrows;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if ((asn_subid_t)ROW_INDEX(ti, ti->rows[mid]) < idx)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
+
+void *
+table_index_find(struct table_index *ti, asn_subid_t idx)
+{
+	u_int pos;
+
+	if (idx > INT32_MAX)
+		return (NULL);
+	pos = ti->cursor;
+	if (pos >= ti->nrows ||
+	    (asn_subid_t)ROW_INDEX(ti, ti->rows[pos]) != idx)
+		pos = table_index_search(ti, idx);
+	if (pos >= ti->nrows ||
+	    (asn_subid_t)ROW_INDEX(ti, ti->rows[pos]) != idx)
+		return (NULL);
+	ti->cursor = pos;
+	return (ti->rows[pos]);
+}
+
+/*
+ * Find the row following the index in the oid, like NEXT_OBJECT_INT().
+ */
+void *
+table_index_next(struct table_index *ti, const struct asn_oid *oid, u_int sub)
+{
+	asn_subid_t idx;
+	u_int pos;
+
+	if (oid->len - sub == 0) {
+		pos = 0;
+	} else {
+		idx = oid->subs[sub];
+		if (idx > INT32_MAX)
+			return (NULL);
+		pos = ti->cursor;
+		if (pos < ti->nrows &&
+		    (asn_subid_t)ROW_INDEX(ti, ti->rows[pos]) == idx)
+			pos++;		/* Walk continues. */
+		else
+			pos = table_index_search(ti, idx + 1);
+	}
+	if (pos >= ti->nrows)
+		return (NULL);
+	ti->cursor = pos;
+	return (ti->rows[pos]);
+}
+
+void
+table_index_free(struct table_index *ti)
+{
+
+	free(ti->rows);
+	ti->rows = NULL;
+	ti->size = 0;
+	table_index_clear(ti);
+}